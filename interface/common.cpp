@@ -28,13 +28,22 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "common.h"
 #include <SDL_keycode.h>
-#include <QProcess>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QElapsedTimer>
 #include "version.h"
 #include "mainwindow.h"
 #include "logviewer.h"
 #include "core_commands.h"
+#include "rom_archive.h"
+#include "rom_cache.h"
+#include "startupprofiler.h"
+#include "frame_stats.h"
+#include "log_ring.h"
 
 /*********************************************************************************************************
  *  Callback functions from the core
@@ -53,32 +62,16 @@ void DebugMessage(int level, const char *message, ...)
   va_end(args);
 }
 
+/* Runs on whichever thread the core or a plugin logs from: the message is
+   copied into the log ring and formatted later by its writer thread. */
 void DebugCallback(void *Context, int level, const char *message)
 {
-    QString output;
+    if (level == M64MSG_ERROR && strstr(message, "Netplay"))
+        w->getWorkerThread()->showMessage(QString::fromUtf8(message));
+    else if (level == M64MSG_VERBOSE && (w == nullptr || !w->getVerbose()))
+        return;
 
-    if (level == M64MSG_ERROR)
-    {
-        output = QString("%1 Error: %2\n").arg((const char *) Context, message);
-        QString netplay = QString::fromUtf8(message);
-        if (netplay.contains("Netplay"))
-            w->getWorkerThread()->showMessage(netplay);
-    }
-    else if (level == M64MSG_WARNING)
-        output = QString("%1 Warning: %2\n").arg((const char *) Context, message);
-    else if (level == M64MSG_INFO)
-            output = QString("%1: %2\n").arg((const char *) Context, message);
-    else if (level == M64MSG_STATUS)
-            output = QString("%1 Status: %2\n").arg((const char *) Context, message);
-    else if (level == M64MSG_VERBOSE)
-    {
-        if (w->getVerbose())
-            output = QString("%1: %2\n").arg((const char *) Context, message);
-    }
-    else
-        output = QString("%1 Unknown: %2\n").arg((const char *) Context, message);
-    if (w != nullptr && !output.isEmpty())
-        w->getLogViewer()->addLog(output);
+    logRingPush(level, (const char *) Context, message);
 }
 
 static char* media_loader_get_gb_cart_rom(void*, int control_id)
@@ -159,29 +152,54 @@ m64p_error loadROM(std::string filename)
 {
     char *ROM_buffer = NULL;
     size_t romlength = 0;
+    QByteArray archive_data;
+    QFile file;
+    uchar *mapped = NULL;
+    const char *load_path;
+    QElapsedTimer timer;
+    timer.start();
+
+    QString romfile = QString::fromStdString(filename);
+    QString suffix = QFileInfo(romfile).suffix().toLower();
+    bool archive = suffix == "zip" || suffix == "7z";
+    bool cached = false;
+    if (archive)
+    {
+        /* a cached image goes through the same mapped path as a plain ROM */
+        QString cache_path = romCacheLookup(romfile);
+        if (!cache_path.isEmpty())
+        {
+            romfile = cache_path;
+            cached = true;
+        }
+    }
 
-    if (filename.find(".7z") != std::string::npos || (filename.find(".zip") != std::string::npos) || (filename.find(".ZIP") != std::string::npos))
+    if (suffix == "zip" && !cached)
+    {
+        if (zipExtractROM(romfile, &archive_data) != M64ERR_SUCCESS)
+        {
+            DebugMessage(M64MSG_ERROR, "couldn't open file '%s' for reading.", filename.c_str());
+            return M64ERR_INVALID_STATE;
+        }
+        romlength = archive_data.size();
+        ROM_buffer = archive_data.data();
+        load_path = "zip";
+    }
+    else if (suffix == "7z" && !cached)
     {
-        QProcess process;
-        QString command = "7za e -so \"";
-        command += QString::fromStdString(filename);
-        command += "\" *64";
-        process.start(command);
-        process.waitForFinished(-1);
-        QByteArray data = process.readAllStandardOutput();
-        romlength = data.size();
-        if (romlength == 0)
+        if (sevenZipExtractROM(romfile, &archive_data) != M64ERR_SUCCESS)
         {
             DebugMessage(M64MSG_ERROR, "couldn't open file '%s' for reading.", filename.c_str());
             return M64ERR_INVALID_STATE;
         }
-        ROM_buffer = (char *) malloc(romlength);
-        memcpy(ROM_buffer, data.constData(), romlength);
+        romlength = archive_data.size();
+        ROM_buffer = archive_data.data();
+        load_path = "7za";
     }
     else
     {
         /* load ROM image */
-        QFile file(filename.c_str());
+        file.setFileName(romfile);
         if (!file.open(QIODevice::ReadOnly))
         {
             DebugMessage(M64MSG_ERROR, "couldn't open ROM file '%s' for reading.", filename.c_str());
@@ -189,26 +207,51 @@ m64p_error loadROM(std::string filename)
         }
 
         romlength = file.size();
-        QDataStream in(&file);
-        ROM_buffer = (char *) malloc(romlength);
-        if (in.readRawData(ROM_buffer, romlength) == -1)
+        /* the core only reads from the image it is given, so a private mapping of the file saves the heap copy */
+        if (w->getSettings()->value("mapROM").toInt())
+            mapped = file.map(0, romlength, QFileDevice::MapPrivateOption);
+
+        if (mapped)
         {
-            DebugMessage(M64MSG_ERROR, "couldn't read %li bytes from ROM image file '%s'.", romlength, filename.c_str());
-            free(ROM_buffer);
-            file.close();
-            return M64ERR_INVALID_STATE;
+            ROM_buffer = (char *) mapped;
+            load_path = cached ? "cache, mmap" : "mmap";
+        }
+        else
+        {
+            QDataStream in(&file);
+            ROM_buffer = (char *) malloc(romlength);
+            if (in.readRawData(ROM_buffer, romlength) == -1)
+            {
+                DebugMessage(M64MSG_ERROR, "couldn't read %li bytes from ROM image file '%s'.", romlength, filename.c_str());
+                free(ROM_buffer);
+                file.close();
+                return M64ERR_INVALID_STATE;
+            }
+            load_path = cached ? "cache, read" : "read";
         }
-        file.close();
     }
 
     /* Try to load the ROM image into the core */
-    if ((*CoreDoCommand)(M64CMD_ROM_OPEN, (int) romlength, ROM_buffer) != M64ERR_SUCCESS)
+    m64p_error res = (*CoreDoCommand)(M64CMD_ROM_OPEN, (int) romlength, ROM_buffer);
+
+    /* written on a background thread, which shares the extracted image */
+    if (res == M64ERR_SUCCESS && archive && !cached)
+        romCacheStore(romfile, archive_data);
+
+    /* the core copies the ROM image, so we can release this buffer immediately */
+    if (mapped)
+        file.unmap(mapped);
+    else if (archive_data.isEmpty())
+        free(ROM_buffer);
+    file.close();
+
+    if (res != M64ERR_SUCCESS)
     {
         DebugMessage(M64MSG_ERROR, "core failed to open ROM image file '%s'.", filename.c_str());
-        free(ROM_buffer);
         return M64ERR_INVALID_STATE;
     }
-    free(ROM_buffer); /* the core copies the ROM image, so we can release this buffer immediately */
+
+    DebugMessage(M64MSG_INFO, "ROM loaded in %.3f ms (%s, %li bytes)", timer.nsecsElapsed() / 1000000.0, load_path, (long) romlength);
 
     return M64ERR_SUCCESS;
 }
@@ -239,6 +282,7 @@ static void loadPif()
 
 m64p_error launchGame(QString netplay_ip, int netplay_port, int netplay_player)
 {
+    StartupProfiler::begin("launchGame");
     if (!netplay_port)
         loadPif();
 
@@ -254,9 +298,22 @@ m64p_error launchGame(QString netplay_ip, int netplay_port, int netplay_player)
     {
         DebugMessage(M64MSG_WARNING, "couldn't get ROM header information from core library");
         (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
+        StartupProfiler::end("launchGame");
         return M64ERR_INVALID_STATE;
     }
 
+    /* PAL carts run the VI at 50 Hz, everything else at 60 Hz */
+    switch (l_RomHeader.Country_code & 0xFF)
+    {
+        case 0x44: case 0x46: case 0x49: case 0x50:
+        case 0x53: case 0x55: case 0x58: case 0x59:
+            frameStatsReset(50);
+            break;
+        default:
+            frameStatsReset(60);
+            break;
+    }
+
     if ((*CoreDoCommand)(M64CMD_SET_MEDIA_LOADER, sizeof(media_loader), &media_loader) != M64ERR_SUCCESS)
     {
         DebugMessage(M64MSG_WARNING, "Couldn't set media loader, transferpak and GB carts will not work.");
@@ -294,6 +351,7 @@ m64p_error launchGame(QString netplay_ip, int netplay_port, int netplay_player)
     }
 
     /* run the game */
+    StartupProfiler::end("launchGame");
     (*CoreDoCommand)(M64CMD_EXECUTE, 0, NULL);
 
     if (netplay_port)
@@ -0,0 +1,516 @@
+#include "frame_capture.h"
+#include "common.h"
+#include "core_commands.h"
+#include "frame_stats.h"
+#include <QAtomicInt>
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QOpenGLFunctions>
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtConcurrent>
+
+#define CAPTURE_SLOTS   3
+/* frames a readback is given to complete before it is mapped */
+#define CAPTURE_LAG     2
+#define ENCODER_THREADS 2
+/* a longer gap between recorded frames is a pause, not missed ticks */
+#define RECORD_MAX_GAP_S 1
+
+#define GL_PIXEL_PACK_BUFFER         0x88EB
+#define GL_PIXEL_PACK_BUFFER_BINDING 0x88ED
+#define GL_READ_FRAMEBUFFER          0x8CA8
+#define GL_READ_FRAMEBUFFER_BINDING  0x8CAA
+#define GL_STREAM_READ               0x88E1
+#define GL_READ_ONLY                 0x88B8
+
+typedef void *(QOPENGLF_APIENTRYP ptr_glMapBuffer)(GLenum target, GLenum access);
+typedef GLboolean (QOPENGLF_APIENTRYP ptr_glUnmapBuffer)(GLenum target);
+
+/* A slot is busy while its readback is in flight. Once mapped, the pixels
+   are read in place by the encoder threads; users counts those still
+   reading, and the rendering thread unmaps the slot when it drops to 0. */
+struct capture_slot {
+    GLuint pbo = 0;
+    int width = 0;
+    int height = 0;
+    int allocated = 0;
+    bool busy = false;
+    bool record = false;
+    unsigned int frame = 0;
+    qint64 frame_ns = 0;
+    QString filename;
+    const char *mapped = nullptr;
+    QAtomicInt users;
+};
+
+struct record_frame {
+    QByteArray pixels;
+    int width = 0;
+    int height = 0;
+    qint64 frame_ns = 0;
+};
+
+/* Writes queued frames as 4:2:0 Y4M. The frame size is fixed by the first
+   frame; later frames of another size are scaled to it. Y4M has a constant
+   frame rate, so frames are placed on a fps tick schedule by the time they
+   were presented: the previous frame is repeated for every tick that got no
+   frame (games running below the VI rate, dropped frames) and a second
+   frame within one tick is skipped. */
+class FrameRecorder : public QThread
+{
+public:
+    FrameRecorder(int fps, int queue_frames) : m_fps(fps), m_frames(queue_frames)
+    {
+        for (int i = 0; i < queue_frames; ++i)
+            m_spare.enqueue(i);
+    }
+    bool open(const QString &filename)
+    {
+        m_file.setFileName(filename);
+        return m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    void push(struct capture_slot *slot);
+    void finish();
+    int written = 0;
+    int repeated = 0;
+    int dropped = 0;
+protected:
+    void run() Q_DECL_OVERRIDE;
+private:
+    void copySlot(struct capture_slot *slot);
+    void writeFrame(const struct record_frame *frame);
+    void writeYuv();
+    QFile m_file;
+    int m_fps;
+    int m_width = 0;
+    int m_height = 0;
+    qint64 m_start_ns = 0;
+    qint64 m_ticks = 0;
+    bool m_finishing = false;
+    QByteArray m_yuv;
+    QVector<struct record_frame> m_frames;
+    QQueue<int> m_spare;
+    QQueue<int> m_filled;
+    QQueue<struct capture_slot *> m_mapped;
+    QMutex m_mutex;
+    QWaitCondition m_ready;
+};
+
+static struct capture_slot capture_slots[CAPTURE_SLOTS];
+static int slot_head;
+static int in_flight;
+static unsigned int frame_counter;
+
+static QAtomicInt screenshots_armed;
+static QMutex name_mutex;
+static QString screenshot_base;
+static int screenshot_index;
+
+static QAtomicInt recording;
+static QMutex record_mutex;
+static FrameRecorder *recorder;
+
+static int resolved;
+static ptr_glMapBuffer MapBuffer;
+static ptr_glUnmapBuffer UnmapBuffer;
+
+/* Rendering thread: only queues the mapped slot, the pixels are copied out
+   of it on the recorder thread. */
+void FrameRecorder::push(struct capture_slot *slot)
+{
+    m_mutex.lock();
+    m_mapped.enqueue(slot);
+    m_ready.wakeOne();
+    m_mutex.unlock();
+}
+
+/* Recorder thread, m_mutex held. Mapped slots are copied before anything
+   is encoded, so the rendering thread gets them back within one frame. */
+void FrameRecorder::copySlot(struct capture_slot *slot)
+{
+    int index = -1;
+    if (m_spare.isEmpty())
+        ++dropped;
+    else
+        index = m_spare.dequeue();
+    m_mutex.unlock();
+
+    if (index != -1)
+    {
+        struct record_frame *frame = &m_frames.data()[index];
+        frame->pixels.resize(slot->width * slot->height * 4);
+        memcpy(frame->pixels.data(), slot->mapped, frame->pixels.size());
+        frame->width = slot->width;
+        frame->height = slot->height;
+        frame->frame_ns = slot->frame_ns;
+    }
+    slot->users.deref();
+
+    m_mutex.lock();
+    if (index != -1)
+        m_filled.enqueue(index);
+}
+
+void FrameRecorder::finish()
+{
+    m_mutex.lock();
+    m_finishing = true;
+    m_ready.wakeOne();
+    m_mutex.unlock();
+    wait();
+    m_file.close();
+}
+
+void FrameRecorder::run()
+{
+    m_mutex.lock();
+    for (;;)
+    {
+        while (m_mapped.isEmpty() && m_filled.isEmpty() && !m_finishing)
+            m_ready.wait(&m_mutex);
+        if (!m_mapped.isEmpty())
+        {
+            copySlot(m_mapped.dequeue());
+            continue;
+        }
+        if (m_filled.isEmpty())
+            break;
+        int index = m_filled.dequeue();
+        m_mutex.unlock();
+        writeFrame(&m_frames.at(index));
+        m_mutex.lock();
+        m_spare.enqueue(index);
+    }
+    m_mutex.unlock();
+}
+
+static inline uchar clampByte(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+void FrameRecorder::writeYuv()
+{
+    m_file.write("FRAME\n", 6);
+    if (m_file.write(m_yuv) == m_yuv.size())
+        ++written;
+    ++m_ticks;
+}
+
+void FrameRecorder::writeFrame(const struct record_frame *frame)
+{
+    if (m_width == 0)
+    {
+        if (frame->width < 2 || frame->height < 2)
+            return;
+        m_width = frame->width & ~1;
+        m_height = frame->height & ~1;
+        QByteArray header = QString("YUV4MPEG2 W%1 H%2 F%3:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n").arg(m_width).arg(m_height).arg(m_fps).toLatin1();
+        m_file.write(header);
+        m_yuv.resize(m_width * m_height * 3 / 2);
+        m_start_ns = frame->frame_ns;
+    }
+    else
+    {
+        qint64 tick = ((frame->frame_ns - m_start_ns) * m_fps + 500000000LL) / 1000000000LL;
+        if (tick < m_ticks)
+            return;
+        if (tick - m_ticks > (qint64) m_fps * RECORD_MAX_GAP_S)
+        {
+            m_start_ns = frame->frame_ns - m_ticks * 1000000000LL / m_fps;
+            tick = m_ticks;
+        }
+        for (; m_ticks < tick; ++repeated)
+            writeYuv();
+    }
+    /* GL rows start at the bottom */
+    QImage scaled;
+    const uchar *pixels = (const uchar *) frame->pixels.constData();
+    int stride = -frame->width * 4;
+    pixels += (frame->height - 1) * frame->width * 4;
+    if ((frame->width & ~1) != m_width || (frame->height & ~1) != m_height)
+    {
+        QImage image((const uchar *) frame->pixels.constData(), frame->width, frame->height, frame->width * 4, QImage::Format_RGBX8888);
+        scaled = image.mirrored().scaled(m_width, m_height);
+        pixels = scaled.constBits();
+        stride = scaled.bytesPerLine();
+    }
+
+    /* full range BT.601, chroma averaged over each 2x2 block */
+    uchar *y_plane = (uchar *) m_yuv.data();
+    uchar *u_plane = y_plane + m_width * m_height;
+    uchar *v_plane = u_plane + m_width * m_height / 4;
+    for (int y = 0; y < m_height; y += 2)
+    {
+        const uchar *row0 = pixels + y * stride;
+        const uchar *row1 = row0 + stride;
+        for (int x = 0; x < m_width; x += 2)
+        {
+            const uchar *p[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+            uchar *luma[4] = { y_plane + y * m_width + x, y_plane + y * m_width + x + 1,
+                               y_plane + (y + 1) * m_width + x, y_plane + (y + 1) * m_width + x + 1 };
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                *luma[i] = (77 * p[i][0] + 150 * p[i][1] + 29 * p[i][2] + 128) >> 8;
+                r += p[i][0];
+                g += p[i][1];
+                b += p[i][2];
+            }
+            int chroma = (y / 2) * (m_width / 2) + x / 2;
+            u_plane[chroma] = clampByte(((-43 * r - 85 * g + 128 * b + 512) >> 10) + 128);
+            v_plane[chroma] = clampByte(((128 * r - 107 * g - 21 * b + 512) >> 10) + 128);
+        }
+    }
+
+    writeYuv();
+}
+
+static QThreadPool *encoderPool()
+{
+    static QThreadPool *pool = nullptr;
+    if (pool == nullptr)
+    {
+        pool = new QThreadPool;
+        pool->setMaxThreadCount(ENCODER_THREADS);
+    }
+    return pool;
+}
+
+/* Encoder pool: reads the slot while it is still mapped, the slot is given
+   back as soon as the image has its own flipped copy. */
+static void encodeScreenshot(struct capture_slot *slot)
+{
+    /* GL rows start at the bottom */
+    QImage image((const uchar *) slot->mapped, slot->width, slot->height, slot->width * 4, QImage::Format_RGBX8888);
+    QImage flipped = image.mirrored();
+    QString filename = slot->filename;
+    slot->users.deref();
+
+    if (flipped.save(filename, "PNG"))
+        DebugMessage(M64MSG_INFO, "screenshot saved to '%s'", filename.toUtf8().constData());
+    else
+        DebugMessage(M64MSG_WARNING, "couldn't write screenshot '%s'.", filename.toUtf8().constData());
+}
+
+void frameCaptureScreenshot(int count, const QString &basename)
+{
+    name_mutex.lock();
+    if (screenshot_base != basename)
+    {
+        screenshot_base = basename;
+        screenshot_index = 0;
+    }
+    name_mutex.unlock();
+    screenshots_armed.fetchAndAddOrdered(count);
+}
+
+bool frameCaptureRecordStart(const QString &filename, int fps, int queue_frames)
+{
+    frameCaptureRecordStop();
+
+    FrameRecorder *next = new FrameRecorder(qMax(fps, 1), qMax(queue_frames, 1));
+    if (!next->open(filename))
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't open '%s' for recording.", filename.toUtf8().constData());
+        delete next;
+        return false;
+    }
+    next->start();
+
+    record_mutex.lock();
+    recorder = next;
+    record_mutex.unlock();
+    recording.store(1);
+    DebugMessage(M64MSG_INFO, "recording to '%s'", filename.toUtf8().constData());
+    return true;
+}
+
+void frameCaptureRecordStop()
+{
+    recording.store(0);
+    record_mutex.lock();
+    FrameRecorder *last = recorder;
+    recorder = nullptr;
+    record_mutex.unlock();
+    if (last == nullptr)
+        return;
+
+    last->finish();
+    DebugMessage(M64MSG_INFO, "recording stopped: %d frames written (%d repeated), %d dropped", last->written, last->repeated, last->dropped);
+    delete last;
+}
+
+bool frameCaptureRecording()
+{
+    return recording.load();
+}
+
+int frameCaptureActive()
+{
+    return screenshots_armed.load() || recording.load() || in_flight;
+}
+
+static void unmapSlot(QOpenGLFunctions *f, struct capture_slot *slot)
+{
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    slot->mapped = nullptr;
+    --in_flight;
+}
+
+/* Maps a finished readback and hands it to the recorder and the encoder
+   pool without copying it here; it stays in flight until they're done. */
+static void collectSlot(QOpenGLFunctions *f, struct capture_slot *slot)
+{
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    slot->mapped = (const char *) MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    slot->busy = false;
+    if (slot->mapped == nullptr)
+    {
+        --in_flight;
+        return;
+    }
+
+    bool screenshot = !slot->filename.isEmpty();
+    slot->users.store((slot->record ? 1 : 0) + (screenshot ? 1 : 0) + 1);
+    if (slot->record)
+    {
+        record_mutex.lock();
+        if (recorder)
+            recorder->push(slot);
+        else
+            slot->users.deref();
+        record_mutex.unlock();
+    }
+    if (screenshot)
+        QtConcurrent::run(encoderPool(), encodeScreenshot, slot);
+    /* the reference held while handing it out */
+    if (!slot->users.deref())
+        unmapSlot(f, slot);
+}
+
+static bool resolveFunctions(QOpenGLContext *context)
+{
+    if (!resolved)
+    {
+        resolved = 1;
+        MapBuffer = (ptr_glMapBuffer) context->getProcAddress("glMapBuffer");
+        UnmapBuffer = (ptr_glUnmapBuffer) context->getProcAddress("glUnmapBuffer");
+        if (!MapBuffer || !UnmapBuffer)
+            DebugMessage(M64MSG_WARNING, "pixel buffer objects not available, screenshots are taken by the core and recording is disabled");
+    }
+    return MapBuffer && UnmapBuffer;
+}
+
+void frameCaptureFrame(QOpenGLContext *context, GLuint framebuffer, int width, int height)
+{
+    ++frame_counter;
+    if (!resolveFunctions(context))
+    {
+        while (screenshots_armed.load() > 0)
+        {
+            (*CoreDoCommand)(M64CMD_TAKE_NEXT_SCREENSHOT, 0, NULL);
+            screenshots_armed.deref();
+        }
+        return;
+    }
+
+    QOpenGLFunctions *f = context->functions();
+    GLint prev_pack = 0;
+    GLint prev_read = 0;
+    f->glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &prev_pack);
+    f->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev_read);
+
+    for (int i = 0; i < CAPTURE_SLOTS; ++i)
+    {
+        if (capture_slots[i].mapped && capture_slots[i].users.loadAcquire() == 0)
+            unmapSlot(f, &capture_slots[i]);
+        if (capture_slots[i].busy && frame_counter - capture_slots[i].frame >= CAPTURE_LAG)
+            collectSlot(f, &capture_slots[i]);
+    }
+
+    bool screenshot = screenshots_armed.load() > 0;
+    bool record = recording.load();
+    if (screenshot || record)
+    {
+        struct capture_slot *slot = &capture_slots[slot_head];
+        /* every slot is still in flight: take the oldest one's hit now */
+        if (slot->busy)
+            collectSlot(f, slot);
+    }
+    /* the encoders are behind: this frame isn't read back (the recording
+       repeats the previous one, an armed screenshot takes the next) */
+    if ((screenshot || record) && !capture_slots[slot_head].mapped)
+    {
+        struct capture_slot *slot = &capture_slots[slot_head];
+        slot_head = (slot_head + 1) % CAPTURE_SLOTS;
+
+        if (slot->pbo == 0)
+            f->glGenBuffers(1, &slot->pbo);
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        if (slot->allocated != width * height * 4)
+        {
+            slot->allocated = width * height * 4;
+            f->glBufferData(GL_PIXEL_PACK_BUFFER, slot->allocated, NULL, GL_STREAM_READ);
+        }
+        if ((GLuint) prev_read != framebuffer)
+            f->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        f->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        if ((GLuint) prev_read != framebuffer)
+            f->glBindFramebuffer(GL_READ_FRAMEBUFFER, prev_read);
+
+        slot->width = width;
+        slot->height = height;
+        slot->frame = frame_counter;
+        slot->frame_ns = frameStatsClock();
+        slot->busy = true;
+        slot->record = record;
+        slot->filename.clear();
+        if (screenshot)
+        {
+            name_mutex.lock();
+            slot->filename = QString("%1-%2.png").arg(screenshot_base).arg(screenshot_index++, 3, 10, QChar('0'));
+            name_mutex.unlock();
+            screenshots_armed.deref();
+        }
+        ++in_flight;
+    }
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, prev_pack);
+}
+
+void frameCaptureRelease(QOpenGLContext *context)
+{
+    if (resolveFunctions(context))
+    {
+        QOpenGLFunctions *f = context->functions();
+        for (int i = 0; i < CAPTURE_SLOTS; ++i)
+        {
+            if (capture_slots[i].busy)
+                collectSlot(f, &capture_slots[i]);
+        }
+        /* the recorder and the encoders give back what they were handed */
+        frameCaptureRecordStop();
+        encoderPool()->waitForDone();
+        for (int i = 0; i < CAPTURE_SLOTS; ++i)
+        {
+            if (capture_slots[i].mapped)
+                unmapSlot(f, &capture_slots[i]);
+            if (capture_slots[i].pbo)
+                f->glDeleteBuffers(1, &capture_slots[i].pbo);
+            capture_slots[i] = capture_slot();
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    frameCaptureRecordStop();
+    slot_head = 0;
+    in_flight = 0;
+    resolved = 0;
+    screenshots_armed.store(0);
+}
@@ -0,0 +1,33 @@
+#ifndef __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include <QOpenGLContext>
+#include <QString>
+
+/* Arms the next count presented frames to be saved as basename-N.png. Safe
+   to call from any thread. */
+void frameCaptureScreenshot(int count, const QString &basename);
+
+/* Starts recording the presented frames to a Y4M file at fps frames per
+   second, repeating the last frame where no new one was presented in time.
+   At most queue_frames frames wait for the encoder thread; frames arriving
+   while the queue is full are dropped rather than slowing emulation down. */
+bool frameCaptureRecordStart(const QString &filename, int fps, int queue_frames);
+void frameCaptureRecordStop();
+bool frameCaptureRecording();
+
+/* Non-zero while a capture is armed or a readback is still in flight. */
+int frameCaptureActive();
+
+/* Called by the swap hook on the rendering thread before the buffers are
+   swapped. Starts an asynchronous readback of the finished frame into a
+   pixel buffer object and hands the mapped readbacks of earlier frames to
+   the encoder threads, so the emulation thread never waits for the GPU,
+   copies pixels or compresses PNGs. */
+void frameCaptureFrame(QOpenGLContext *context, GLuint framebuffer, int width, int height);
+
+/* Rendering thread, context current: completes the readbacks in flight,
+   stops any recording and frees the buffers. */
+void frameCaptureRelease(QOpenGLContext *context);
+
+#endif /* __FRAME_CAPTURE_H__ */
@@ -0,0 +1,173 @@
+#include "frame_stats.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QVector>
+#include <algorithm>
+
+#define RING_SIZE        1024
+#define BUCKET_NS        100000
+#define BUCKET_COUNT     2000
+
+struct frame_sample {
+    qint64 time_ns;
+    qint64 interval_ns;
+    qint64 swap_ns;
+    qint64 wait_ns;
+};
+
+static QElapsedTimer stats_clock;
+static double target_period_ns = 1e9 / 60;
+
+/* written by the rendering thread only, published through ring_count */
+static struct frame_sample ring[RING_SIZE];
+static QAtomicInt ring_count;
+
+static qint64 last_frame_ns;
+static int histogram[BUCKET_COUNT + 1];
+static int session_frames;
+static int session_late;
+static qint64 session_first_ns;
+static qint64 session_last_ns;
+static qint64 session_swap_ns;
+static qint64 session_swap_max;
+static qint64 session_wait_ns;
+
+void frameStatsReset(double target_hz)
+{
+    stats_clock.start();
+    target_period_ns = 1e9 / target_hz;
+    ring_count.store(0);
+    last_frame_ns = 0;
+    std::fill(histogram, histogram + BUCKET_COUNT + 1, 0);
+    session_frames = 0;
+    session_late = 0;
+    session_first_ns = 0;
+    session_last_ns = 0;
+    session_swap_ns = 0;
+    session_swap_max = 0;
+    session_wait_ns = 0;
+}
+
+double frameStatsTargetHz()
+{
+    return 1e9 / target_period_ns;
+}
+
+qint64 frameStatsClock()
+{
+    return stats_clock.nsecsElapsed();
+}
+
+void frameStatsRecord(qint64 frame_ns, qint64 swap_ns, qint64 wait_ns)
+{
+    qint64 interval = last_frame_ns ? frame_ns - last_frame_ns : 0;
+    last_frame_ns = frame_ns;
+
+    int count = ring_count.load();
+    struct frame_sample *sample = &ring[(unsigned) count % RING_SIZE];
+    sample->time_ns = frame_ns;
+    sample->interval_ns = interval;
+    sample->swap_ns = swap_ns;
+    sample->wait_ns = wait_ns;
+    ring_count.storeRelease(count + 1);
+
+    if (session_frames == 0)
+        session_first_ns = frame_ns;
+    session_last_ns = frame_ns;
+    session_swap_ns += swap_ns;
+    session_swap_max = qMax(session_swap_max, swap_ns);
+    session_wait_ns += wait_ns;
+    ++session_frames;
+    if (interval == 0)
+        return;
+    histogram[qMin(interval / BUCKET_NS, (qint64) BUCKET_COUNT)]++;
+    if (interval > target_period_ns * 1.5)
+        ++session_late;
+}
+
+static double percentile(const QVector<qint64> &sorted, double p)
+{
+    int index = qMin((int) (p * sorted.size()), sorted.size() - 1);
+    return sorted.at(index) / 1e6;
+}
+
+void frameStatsRecent(struct frame_stats *stats, int frames)
+{
+    *stats = frame_stats();
+    stats->target_hz = 1e9 / target_period_ns;
+
+    int end = ring_count.loadAcquire();
+    int begin = qMax(end - qMin(frames, RING_SIZE / 2), 0);
+    QVector<struct frame_sample> samples;
+    samples.reserve(end - begin);
+    for (int i = begin; i < end; ++i)
+        samples.append(ring[(unsigned) i % RING_SIZE]);
+
+    /* the producer may have lapped the reader while copying, drop any slot
+       that could have been rewritten */
+    int overwritten = ring_count.loadAcquire() - RING_SIZE - begin;
+    if (overwritten > 0)
+        samples.remove(0, qMin(overwritten, samples.size()));
+
+    QVector<qint64> intervals;
+    intervals.reserve(samples.size());
+    qint64 swap_total = 0;
+    qint64 wait_total = 0;
+    for (int i = 0; i < samples.size(); ++i)
+    {
+        swap_total += samples.at(i).swap_ns;
+        wait_total += samples.at(i).wait_ns;
+        stats->swap_max = qMax(stats->swap_max, samples.at(i).swap_ns / 1e6);
+        if (samples.at(i).interval_ns == 0)
+            continue;
+        intervals.append(samples.at(i).interval_ns);
+        if (samples.at(i).interval_ns > target_period_ns * 1.5)
+            ++stats->late;
+    }
+    if (intervals.isEmpty())
+        return;
+
+    std::sort(intervals.begin(), intervals.end());
+    stats->frames = samples.size();
+    stats->fps = (samples.size() - 1) * 1e9 / qMax(samples.last().time_ns - samples.first().time_ns, (qint64) 1);
+    stats->p50 = percentile(intervals, 0.50);
+    stats->p95 = percentile(intervals, 0.95);
+    stats->p99 = percentile(intervals, 0.99);
+    stats->swap_avg = swap_total / 1e6 / samples.size();
+    stats->wait_avg = wait_total / 1e6 / samples.size();
+}
+
+void frameStatsSession(struct frame_stats *stats)
+{
+    *stats = frame_stats();
+    stats->target_hz = 1e9 / target_period_ns;
+    stats->frames = session_frames;
+    stats->late = session_late;
+    if (session_frames < 2)
+        return;
+
+    stats->fps = (session_frames - 1) * 1e9 / qMax(session_last_ns - session_first_ns, (qint64) 1);
+    stats->swap_avg = session_swap_ns / 1e6 / session_frames;
+    stats->swap_max = session_swap_max / 1e6;
+    stats->wait_avg = session_wait_ns / 1e6 / session_frames;
+
+    int total = 0;
+    for (int i = 0; i <= BUCKET_COUNT; ++i)
+        total += histogram[i];
+    double *targets[3] = { &stats->p50, &stats->p95, &stats->p99 };
+    double fractions[3] = { 0.50, 0.95, 0.99 };
+    for (int p = 0; p < 3; ++p)
+    {
+        int seen = 0;
+        for (int i = 0; i <= BUCKET_COUNT; ++i)
+        {
+            seen += histogram[i];
+            if (seen > fractions[p] * total)
+            {
+                /* bucket midpoint */
+                *targets[p] = (i + 0.5) * BUCKET_NS / 1e6;
+                break;
+            }
+        }
+    }
+}
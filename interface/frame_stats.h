@@ -0,0 +1,45 @@
+#ifndef __FRAME_STATS_H__
+#define __FRAME_STATS_H__
+
+#include <QtGlobal>
+
+struct frame_stats {
+    int frames = 0;
+    double fps = 0;
+    double target_hz = 0;
+    /* frame-to-frame interval percentiles, in ms */
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    /* intervals longer than 1.5 VI periods; games that render below the VI
+       rate land here on every frame */
+    int late = 0;
+    /* time spent inside the driver's swapBuffers, in ms */
+    double swap_avg = 0;
+    double swap_max = 0;
+    /* time spent waiting for queued frames to finish (presentation queue
+       limit), in ms */
+    double wait_avg = 0;
+};
+
+/* Starts a new session, called before the game runs. */
+void frameStatsReset(double target_hz);
+
+/* VI rate the session was reset with. */
+double frameStatsTargetHz();
+
+/* Monotonic clock the samples are taken with, in ns. */
+qint64 frameStatsClock();
+
+/* Called by the swap hook on the rendering thread once per frame. Lock-free
+   and allocation-free: one ring slot and one histogram bucket are written. */
+void frameStatsRecord(qint64 frame_ns, qint64 swap_ns, qint64 wait_ns);
+
+/* Stats over the most recent frames (at most the ring size), safe to call
+   from any thread while the game runs. */
+void frameStatsRecent(struct frame_stats *stats, int frames);
+
+/* Stats over the whole session, from the histogram. */
+void frameStatsSession(struct frame_stats *stats);
+
+#endif /* __FRAME_STATS_H__ */
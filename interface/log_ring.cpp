@@ -0,0 +1,205 @@
+#include "log_ring.h"
+#include "common.h"
+#include "mainwindow.h"
+#include "logviewer.h"
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+#include <string.h>
+
+#define LOG_RING_SIZE   4096
+#define LOG_SOURCE_LEN  16
+#define LOG_MESSAGE_LEN 488
+/* "…" in UTF-8, ends a line that didn't fit */
+#define TRUNCATED_MARK     "\xE2\x80\xA6"
+#define TRUNCATED_MARK_LEN 3
+/* once woken, the writer waits this long so a burst goes out as one batch */
+#define LOG_FLUSH_MS    20
+
+struct log_record {
+    /* position + 1 once the slot is written, position + LOG_RING_SIZE once
+       the writer has consumed it */
+    QAtomicInteger<quint32> sequence;
+    int level;
+    qint64 time_ns;
+    char source[LOG_SOURCE_LEN];
+    char message[LOG_MESSAGE_LEN];
+};
+
+class LogWriter : public QThread
+{
+public:
+    QAtomicInt stopping;
+protected:
+    void run() Q_DECL_OVERRIDE;
+};
+
+static struct log_record ring[LOG_RING_SIZE];
+static QAtomicInteger<quint32> enqueue_pos;
+static QAtomicInt dropped;
+/* records published and not yet consumed; the producer that takes it from
+   0 to 1 releases wake, so an idle writer sleeps instead of polling */
+static QAtomicInt queued;
+static QSemaphore wake;
+static quint32 dequeue_pos;
+static QElapsedTimer log_clock;
+static LogWriter *writer;
+
+static bool initRing()
+{
+    for (quint32 i = 0; i < LOG_RING_SIZE; ++i)
+        ring[i].sequence.store(i);
+    log_clock.start();
+    return true;
+}
+
+/* ready before main() runs, so nothing logged early is lost */
+static bool ring_ready = initRing();
+
+/* A string that doesn't fit is cut on a UTF-8 character boundary and ends
+   in an ellipsis, so a truncated line can't pass for a complete one. */
+static void copyString(char *dest, const char *src, int size)
+{
+    int len = 0;
+    if (src)
+    {
+        while (len < size - 1 && src[len])
+            ++len;
+        if (len == size - 1 && src[len])
+        {
+            len = size - 1 - TRUNCATED_MARK_LEN;
+            while (len > 0 && (src[len] & 0xC0) == 0x80)
+                --len;
+            memcpy(dest + len, TRUNCATED_MARK, TRUNCATED_MARK_LEN);
+            memcpy(dest, src, len);
+            len += TRUNCATED_MARK_LEN;
+        }
+        else
+            memcpy(dest, src, len);
+    }
+    dest[len] = 0;
+}
+
+void logRingPush(int level, const char *source, const char *message)
+{
+    quint32 pos = enqueue_pos.load();
+    struct log_record *record;
+    for (;;)
+    {
+        record = &ring[pos % LOG_RING_SIZE];
+        qint32 diff = (qint32) (record->sequence.loadAcquire() - pos);
+        if (diff == 0)
+        {
+            if (enqueue_pos.testAndSetRelaxed(pos, pos + 1))
+                break;
+            pos = enqueue_pos.load();
+        }
+        else if (diff < 0)
+        {
+            dropped.ref();
+            return;
+        }
+        else
+            pos = enqueue_pos.load();
+    }
+
+    record->level = level;
+    record->time_ns = log_clock.nsecsElapsed();
+    copyString(record->source, source, LOG_SOURCE_LEN);
+    copyString(record->message, message, LOG_MESSAGE_LEN);
+    record->sequence.storeRelease(pos + 1);
+    if (queued.fetchAndAddRelease(1) == 0)
+        wake.release();
+}
+
+static QString timePrefix(qint64 time_ns)
+{
+    return QString("[%1] ").arg(time_ns / 1e9, 8, 'f', 3);
+}
+
+static QString formatRecord(const struct log_record *record)
+{
+    QString time = timePrefix(record->time_ns);
+    QString source = QString::fromUtf8(record->source);
+    QString message = QString::fromUtf8(record->message);
+    switch (record->level)
+    {
+    case M64MSG_ERROR:
+        return time + QString("%1 Error: %2\n").arg(source, message);
+    case M64MSG_WARNING:
+        return time + QString("%1 Warning: %2\n").arg(source, message);
+    case M64MSG_INFO:
+    case M64MSG_VERBOSE:
+        return time + QString("%1: %2\n").arg(source, message);
+    case M64MSG_STATUS:
+        return time + QString("%1 Status: %2\n").arg(source, message);
+    default:
+        return time + QString("%1 Unknown: %2\n").arg(source, message);
+    }
+}
+
+/* Writer thread only. Returns the number of records written. */
+static int drainRing()
+{
+    QString batch;
+    int count = 0;
+    for (;;)
+    {
+        struct log_record *record = &ring[dequeue_pos % LOG_RING_SIZE];
+        if ((qint32) (record->sequence.loadAcquire() - (dequeue_pos + 1)) != 0)
+            break;
+        batch += formatRecord(record);
+        record->sequence.storeRelease(dequeue_pos + LOG_RING_SIZE);
+        ++dequeue_pos;
+        ++count;
+    }
+
+    int lost = dropped.fetchAndStoreRelaxed(0);
+    if (lost)
+        batch += timePrefix(log_clock.nsecsElapsed()) + QString("GUI Warning: log ring full, %1 messages dropped\n").arg(lost);
+    if (!batch.isEmpty())
+        w->getLogViewer()->addLog(batch);
+    return count;
+}
+
+void LogWriter::run()
+{
+    while (!stopping.load())
+    {
+        wake.acquire();
+        if (!stopping.load())
+            msleep(LOG_FLUSH_MS);
+        /* until the ring is empty again; a producer still filling the next
+           slot only holds the writer up for a moment */
+        for (;;)
+        {
+            int count = drainRing();
+            if (queued.fetchAndAddAcquire(-count) == count)
+                break;
+            if (count == 0)
+                yieldCurrentThread();
+        }
+    }
+    drainRing();
+}
+
+void logRingStart()
+{
+    Q_UNUSED(ring_ready);
+    if (writer)
+        return;
+    writer = new LogWriter;
+    writer->start(QThread::LowPriority);
+}
+
+void logRingStop()
+{
+    if (writer == nullptr)
+        return;
+    writer->stopping.store(1);
+    wake.release();
+    writer->wait();
+    delete writer;
+    writer = nullptr;
+}
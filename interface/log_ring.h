@@ -0,0 +1,20 @@
+#ifndef __LOG_RING_H__
+#define __LOG_RING_H__
+
+/* Log records go into a fixed-size lock-free ring (many producers, one
+   consumer). Producers copy the message into a slot and return; a writer
+   thread, woken when the ring goes from empty to non-empty, formats the
+   records and appends them to the log viewer in batches. When the ring is
+   full, messages are dropped and counted. */
+
+/* Any thread: no allocation, messages are truncated to the slot size. Only
+   the message that finds the ring empty touches the writer's semaphore. */
+void logRingPush(int level, const char *source, const char *message);
+
+/* Starts the writer thread once the main window exists. */
+void logRingStart();
+
+/* Writes out whatever is still queued and stops the writer thread. */
+void logRingStop();
+
+#endif /* __LOG_RING_H__ */
@@ -0,0 +1,208 @@
+#include "rom_archive.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <QFile>
+#include <QProcess>
+
+#define ZIP_EOCD_SIGNATURE      0x06054b50
+#define ZIP_CENTRAL_SIGNATURE   0x02014b50
+#define ZIP_LOCAL_SIGNATURE     0x04034b50
+#define ZIP_EOCD_SIZE           22
+#define ZIP_CENTRAL_SIZE        46
+#define ZIP_LOCAL_SIZE          30
+#define ZIP_MAX_COMMENT         0xFFFF
+#define ZIP_METHOD_STORED       0
+#define ZIP_METHOD_DEFLATE      8
+#define ZIP_FLAG_ENCRYPTED      0x0001
+
+#define INFLATE_CHUNK_SIZE      (1024 * 1024)
+
+static uint16_t read16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t read32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+struct zip_entry {
+    uint16_t method;
+    uint32_t crc;
+    uint32_t compressed_size;
+    uint32_t size;
+    uint32_t local_offset;
+};
+
+static bool findROMEntry(QFile &file, struct zip_entry *entry)
+{
+    qint64 file_size = file.size();
+    if (file_size < ZIP_EOCD_SIZE)
+        return false;
+
+    /* the end of central directory record sits at the very end of the file, followed only by an optional comment */
+    qint64 tail_size = qMin(file_size, (qint64) ZIP_EOCD_SIZE + ZIP_MAX_COMMENT);
+    if (!file.seek(file_size - tail_size))
+        return false;
+    QByteArray tail = file.read(tail_size);
+    if (tail.size() != tail_size)
+        return false;
+
+    const unsigned char *eocd = NULL;
+    const unsigned char *tail_data = (const unsigned char *) tail.constData();
+    for (qint64 i = tail_size - ZIP_EOCD_SIZE; i >= 0; --i)
+    {
+        if (read32(tail_data + i) == ZIP_EOCD_SIGNATURE)
+        {
+            eocd = tail_data + i;
+            break;
+        }
+    }
+    if (eocd == NULL)
+        return false;
+
+    uint16_t entries = read16(eocd + 10);
+    uint32_t central_size = read32(eocd + 12);
+    uint32_t central_offset = read32(eocd + 16);
+    if ((qint64) central_offset + central_size > file_size || !file.seek(central_offset))
+        return false;
+    QByteArray central = file.read(central_size);
+    if (central.size() != (int) central_size)
+        return false;
+
+    const unsigned char *p = (const unsigned char *) central.constData();
+    const unsigned char *end = p + central_size;
+    for (uint16_t i = 0; i < entries && p + ZIP_CENTRAL_SIZE <= end; ++i)
+    {
+        if (read32(p) != ZIP_CENTRAL_SIGNATURE)
+            return false;
+
+        uint16_t name_length = read16(p + 28);
+        uint16_t extra_length = read16(p + 30);
+        uint16_t comment_length = read16(p + 32);
+        if (p + ZIP_CENTRAL_SIZE + name_length > end)
+            return false;
+
+        /* same selection 7za used to make with its "*64" wildcard */
+        QString name = QString::fromUtf8((const char *) p + ZIP_CENTRAL_SIZE, name_length);
+        if (name.endsWith("64", Qt::CaseInsensitive) && !(read16(p + 8) & ZIP_FLAG_ENCRYPTED))
+        {
+            entry->method = read16(p + 10);
+            entry->crc = read32(p + 16);
+            entry->compressed_size = read32(p + 20);
+            entry->size = read32(p + 24);
+            entry->local_offset = read32(p + 42);
+            return true;
+        }
+
+        p += ZIP_CENTRAL_SIZE + name_length + extra_length + comment_length;
+    }
+
+    return false;
+}
+
+static bool inflateEntry(QFile &file, const struct zip_entry *entry, char *buffer)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    /* zip stores raw deflate data, without the zlib header */
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+
+    stream.next_out = (Bytef *) buffer;
+    stream.avail_out = entry->size;
+
+    char *chunk = (char *) malloc(INFLATE_CHUNK_SIZE);
+    uint32_t remaining = entry->compressed_size;
+    int ret = Z_OK;
+    while (ret == Z_OK && remaining > 0)
+    {
+        qint64 bytes = file.read(chunk, qMin(remaining, (uint32_t) INFLATE_CHUNK_SIZE));
+        if (bytes <= 0)
+            break;
+        remaining -= bytes;
+        stream.next_in = (Bytef *) chunk;
+        stream.avail_in = bytes;
+        do {
+            ret = inflate(&stream, Z_NO_FLUSH);
+        } while (ret == Z_OK && stream.avail_in > 0);
+    }
+    free(chunk);
+    inflateEnd(&stream);
+
+    return ret == Z_STREAM_END && stream.total_out == entry->size;
+}
+
+m64p_error zipExtractROM(const QString &filename, QByteArray *output)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't open archive '%s' for reading.", filename.toUtf8().constData());
+        return M64ERR_FILES;
+    }
+
+    struct zip_entry entry;
+    if (!findROMEntry(file, &entry))
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't find an N64 ROM image in archive '%s'.", filename.toUtf8().constData());
+        return M64ERR_INPUT_INVALID;
+    }
+
+    unsigned char local[ZIP_LOCAL_SIZE];
+    if (!file.seek(entry.local_offset) || file.read((char *) local, ZIP_LOCAL_SIZE) != ZIP_LOCAL_SIZE || read32(local) != ZIP_LOCAL_SIGNATURE)
+    {
+        DebugMessage(M64MSG_ERROR, "corrupt local file header in archive '%s'.", filename.toUtf8().constData());
+        return M64ERR_INPUT_INVALID;
+    }
+    if (!file.seek(entry.local_offset + ZIP_LOCAL_SIZE + read16(local + 26) + read16(local + 28)))
+        return M64ERR_FILES;
+
+    if ((int) entry.size < 0)
+        return M64ERR_NO_MEMORY;
+    QByteArray image(entry.size, Qt::Uninitialized);
+    char *data = image.data();
+
+    bool ok = false;
+    if (entry.method == ZIP_METHOD_STORED)
+        ok = entry.compressed_size == entry.size && file.read(data, entry.size) == entry.size;
+    else if (entry.method == ZIP_METHOD_DEFLATE)
+        ok = inflateEntry(file, &entry, data);
+    else
+        DebugMessage(M64MSG_ERROR, "unsupported compression method %u in archive '%s'.", entry.method, filename.toUtf8().constData());
+
+    if (ok && crc32(0, (const Bytef *) data, entry.size) != entry.crc)
+    {
+        DebugMessage(M64MSG_ERROR, "CRC mismatch in archive '%s'.", filename.toUtf8().constData());
+        ok = false;
+    }
+
+    if (!ok)
+        return M64ERR_INPUT_INVALID;
+
+    *output = image;
+    return M64ERR_SUCCESS;
+}
+
+m64p_error sevenZipExtractROM(const QString &filename, QByteArray *data)
+{
+    QProcess process;
+    process.start("7za", QStringList() << "e" << "-so" << filename << "*64");
+    if (!process.waitForStarted())
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't run 7za to extract '%s', make sure it is installed and in your PATH.", filename.toUtf8().constData());
+        return M64ERR_FILES;
+    }
+    process.waitForFinished(-1);
+    *data = process.readAllStandardOutput();
+    if (data->isEmpty())
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't find an N64 ROM image in archive '%s'.", filename.toUtf8().constData());
+        return M64ERR_INPUT_INVALID;
+    }
+
+    return M64ERR_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#ifndef __ROM_ARCHIVE_H__
+#define __ROM_ARCHIVE_H__
+
+#include "m64p_types.h"
+#include <QString>
+#include <QByteArray>
+
+/* Finds the first entry ending in "64" inside a .zip archive and inflates it
+   straight into data, sized to exactly the entry's size. */
+m64p_error zipExtractROM(const QString &filename, QByteArray *data);
+
+/* Runs 7za to extract the first "*64" entry of a .7z archive into data. */
+m64p_error sevenZipExtractROM(const QString &filename, QByteArray *data);
+
+#endif /* __ROM_ARCHIVE_H__ */
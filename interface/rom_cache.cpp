@@ -0,0 +1,114 @@
+#include "rom_cache.h"
+#include "common.h"
+#include "mainwindow.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#define ROM_CACHE_SUFFIX ".rom"
+
+static qint64 cacheLimit()
+{
+    return w->getSettings()->value("romCacheMB").toLongLong() * 1024 * 1024;
+}
+
+static QString cacheDir()
+{
+    QString dir = w->getSettings()->value("romCacheDir").toString();
+    if (dir.isEmpty())
+        dir = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("roms");
+    return dir;
+}
+
+static QString cacheKey(const QString &archive)
+{
+    QFileInfo info(archive);
+    QString id = QString("%1\n%2\n%3").arg(info.absoluteFilePath()).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+    return QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+/* last-use times live in a small ini next to the images, file times are not
+   reliable enough (noatime mounts, no portable way to touch in Qt 5.4) */
+static void touchEntry(const QString &dir, const QString &key)
+{
+    QSettings index(QDir(dir).filePath("index.ini"), QSettings::IniFormat);
+    index.setValue("lastUsed/" + key, QDateTime::currentMSecsSinceEpoch());
+}
+
+static void evict(const QString &dir, qint64 limit)
+{
+    QSettings index(QDir(dir).filePath("index.ini"), QSettings::IniFormat);
+    QFileInfoList files = QDir(dir).entryInfoList(QStringList("*" ROM_CACHE_SUFFIX), QDir::Files);
+
+    qint64 total = 0;
+    QMultiMap<qint64, QFileInfo> byLastUse;
+    for (int i = 0; i < files.size(); ++i)
+    {
+        total += files.at(i).size();
+        byLastUse.insert(index.value("lastUsed/" + files.at(i).completeBaseName(), 0).toLongLong(), files.at(i));
+    }
+
+    QMultiMap<qint64, QFileInfo>::const_iterator oldest = byLastUse.constBegin();
+    while (total > limit && oldest != byLastUse.constEnd())
+    {
+        if (QFile::remove(oldest.value().absoluteFilePath()))
+        {
+            total -= oldest.value().size();
+            index.remove("lastUsed/" + oldest.value().completeBaseName());
+            DebugMessage(M64MSG_VERBOSE, "evicted %s from the ROM cache", oldest.value().fileName().toUtf8().constData());
+        }
+        ++oldest;
+    }
+}
+
+QString romCacheLookup(const QString &archive)
+{
+    if (cacheLimit() <= 0)
+        return QString();
+
+    QString dir = cacheDir();
+    QString key = cacheKey(archive);
+    QString path = QDir(dir).filePath(key + ROM_CACHE_SUFFIX);
+    if (!QFileInfo::exists(path))
+        return QString();
+
+    touchEntry(dir, key);
+    return path;
+}
+
+/* one store at a time, they share the index and the eviction */
+static QMutex store_mutex;
+
+static void storeEntry(QString archive, QByteArray data, QString dir, qint64 limit)
+{
+    QMutexLocker locker(&store_mutex);
+    if (!QDir().mkpath(dir))
+        return;
+
+    QString key = cacheKey(archive);
+    QSaveFile file(QDir(dir).filePath(key + ROM_CACHE_SUFFIX));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        DebugMessage(M64MSG_WARNING, "couldn't write ROM cache entry for '%s'.", archive.toUtf8().constData());
+        return;
+    }
+
+    touchEntry(dir, key);
+    evict(dir, limit);
+}
+
+void romCacheStore(const QString &archive, const QByteArray &data)
+{
+    qint64 limit = cacheLimit();
+    if (limit <= 0 || data.size() > limit)
+        return;
+
+    QtConcurrent::run(storeEntry, archive, data, cacheDir(), limit);
+}
@@ -0,0 +1,20 @@
+#ifndef __ROM_CACHE_H__
+#define __ROM_CACHE_H__
+
+#include <QString>
+#include <QByteArray>
+
+/* Cache of decompressed .zip/.7z ROM images, keyed by the archive's path,
+   size and modification time. Controlled by the "romCacheMB" (size cap,
+   0 disables the cache and is the default) and "romCacheDir" settings. */
+
+/* Returns the path of the cached image for archive, or an empty string on a
+   miss. A hit marks the entry as most recently used. */
+QString romCacheLookup(const QString &archive);
+
+/* Stores a decompressed image for archive and evicts the least recently used
+   entries until the cache fits its size cap again. Returns right away, the
+   image is written on the thread pool. */
+void romCacheStore(const QString &archive, const QByteArray &data);
+
+#endif /* __ROM_CACHE_H__ */
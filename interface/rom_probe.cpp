@@ -0,0 +1,229 @@
+#include "rom_probe.h"
+#include "rom_archive.h"
+#include "common.h"
+#include "core_commands.h"
+#include <stdlib.h>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QTextStream>
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+#define PROBE_CHUNK_SIZE    (4 * 1024 * 1024)
+#define ROM_HEADER_SIZE     64
+
+enum rom_byteorder {
+    ROM_Z64,
+    ROM_V64,
+    ROM_N64,
+    ROM_INVALID
+};
+
+static QMutex romdb_mutex;
+static bool romdb_loaded = false;
+static QHash<QString, QString> romdb_md5;
+static QHash<QString, QString> romdb_crc;
+
+/* Retried on the next lookup until it succeeds, lookups made before the
+   core is loaded just don't find a name. */
+static void loadRomDatabase()
+{
+    if (ConfigGetSharedDataFilepath == nullptr)
+        return;
+
+    const char *path = (*ConfigGetSharedDataFilepath)("mupen64plus.ini");
+    if (path == NULL)
+        return;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+
+    QTextStream in(&file);
+    QString md5;
+    QString crc;
+    while (!in.atEnd())
+    {
+        QString line = in.readLine().trimmed();
+        if (line.startsWith('[') && line.endsWith(']'))
+        {
+            md5 = line.mid(1, line.length() - 2).toUpper();
+            crc.clear();
+        }
+        else if (line.startsWith("CRC="))
+            crc = line.mid(4).toUpper();
+        else if (line.startsWith("GoodName="))
+        {
+            QString goodname = line.mid(9);
+            romdb_md5.insert(md5, goodname);
+            if (!crc.isEmpty() && !romdb_crc.contains(crc))
+                romdb_crc.insert(crc, goodname);
+        }
+    }
+    romdb_loaded = true;
+}
+
+static QString lookupGoodName(const struct rom_identity *identity)
+{
+    QMutexLocker locker(&romdb_mutex);
+    if (!romdb_loaded)
+        loadRomDatabase();
+
+    /* same order as the core: MD5 first, then the header CRCs */
+    QString goodname = romdb_md5.value(identity->md5);
+    if (goodname.isEmpty())
+    {
+        QString crc = QString("%1 %2").arg(identity->crc1, 8, 16, QChar('0')).arg(identity->crc2, 8, 16, QChar('0')).toUpper();
+        goodname = romdb_crc.value(crc);
+    }
+    if (goodname.isEmpty())
+        goodname = identity->headername + " (unknown rom)";
+    return goodname;
+}
+
+static int detectByteOrder(const unsigned char *header)
+{
+    if (header[0] == 0x80 && header[1] == 0x37 && header[2] == 0x12 && header[3] == 0x40)
+        return ROM_Z64;
+    if (header[0] == 0x37 && header[1] == 0x80 && header[2] == 0x40 && header[3] == 0x12)
+        return ROM_V64;
+    if (header[0] == 0x40 && header[1] == 0x12 && header[2] == 0x37 && header[3] == 0x80)
+        return ROM_N64;
+    return ROM_INVALID;
+}
+
+static void swapToBigEndian(char *data, qint64 length, int byteorder)
+{
+    if (byteorder == ROM_V64)
+    {
+        for (qint64 i = 0; i + 1 < length; i += 2)
+        {
+            char temp = data[i];
+            data[i] = data[i + 1];
+            data[i + 1] = temp;
+        }
+    }
+    else if (byteorder == ROM_N64)
+    {
+        for (qint64 i = 0; i + 3 < length; i += 4)
+        {
+            char temp = data[i];
+            data[i] = data[i + 3];
+            data[i + 3] = temp;
+            temp = data[i + 1];
+            data[i + 1] = data[i + 2];
+            data[i + 2] = temp;
+        }
+    }
+}
+
+static uint32_t readBig32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* header must already be in big-endian order */
+static void parseHeader(const unsigned char *header, struct rom_identity *identity)
+{
+    identity->crc1 = readBig32(header + 0x10);
+    identity->crc2 = readBig32(header + 0x14);
+    identity->headername = QString::fromLatin1((const char *) header + 0x20, 20).trimmed();
+    identity->country_code = header[0x3E];
+}
+
+static m64p_error hashImage(char *data, qint64 length, struct rom_identity *identity)
+{
+    if (length < ROM_HEADER_SIZE)
+        return M64ERR_INPUT_INVALID;
+
+    int byteorder = detectByteOrder((const unsigned char *) data);
+    if (byteorder == ROM_INVALID)
+        return M64ERR_INPUT_INVALID;
+
+    swapToBigEndian(data, length, byteorder);
+    parseHeader((const unsigned char *) data, identity);
+    identity->md5 = QCryptographicHash::hash(QByteArray::fromRawData(data, length), QCryptographicHash::Md5).toHex().toUpper();
+    return M64ERR_SUCCESS;
+}
+
+/* ask the kernel to start reading the next chunk while the current one is hashed */
+static void prefetchChunk(QFile *file, qint64 offset)
+{
+#ifdef __linux__
+    posix_fadvise(file->handle(), offset, PROBE_CHUNK_SIZE, POSIX_FADV_WILLNEED);
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(offset);
+#endif
+}
+
+static m64p_error hashFile(const QString &filename, struct rom_identity *identity)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return M64ERR_FILES;
+#ifdef __linux__
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    QByteArray chunk(PROBE_CHUNK_SIZE, 0);
+    qint64 bytes = file.read(chunk.data(), PROBE_CHUNK_SIZE);
+    if (bytes < ROM_HEADER_SIZE)
+        return M64ERR_INPUT_INVALID;
+
+    int byteorder = detectByteOrder((const unsigned char *) chunk.constData());
+    if (byteorder == ROM_INVALID)
+        return M64ERR_INPUT_INVALID;
+
+    swapToBigEndian(chunk.data(), bytes, byteorder);
+    parseHeader((const unsigned char *) chunk.constData(), identity);
+
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    while (bytes > 0)
+    {
+        prefetchChunk(&file, file.pos());
+        md5.addData(chunk.constData(), bytes);
+        bytes = file.read(chunk.data(), PROBE_CHUNK_SIZE);
+        swapToBigEndian(chunk.data(), bytes, byteorder);
+    }
+    if (bytes < 0)
+        return M64ERR_FILES;
+
+    identity->md5 = md5.result().toHex().toUpper();
+    return M64ERR_SUCCESS;
+}
+
+m64p_error probeROM(const QString &filename, struct rom_identity *identity)
+{
+    m64p_error res;
+    QString suffix = QFileInfo(filename).suffix().toLower();
+    if (suffix == "zip")
+    {
+        QByteArray data;
+        res = zipExtractROM(filename, &data);
+        if (res == M64ERR_SUCCESS)
+            res = hashImage(data.data(), data.size(), identity);
+    }
+    else if (suffix == "7z")
+    {
+        QByteArray data;
+        res = sevenZipExtractROM(filename, &data);
+        if (res == M64ERR_SUCCESS)
+            res = hashImage(data.data(), data.size(), identity);
+    }
+    else
+        res = hashFile(filename, identity);
+
+    if (res != M64ERR_SUCCESS)
+    {
+        DebugMessage(M64MSG_WARNING, "couldn't identify ROM image '%s'.", filename.toUtf8().constData());
+        return res;
+    }
+
+    identity->goodname = lookupGoodName(identity);
+    return M64ERR_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#ifndef __ROM_PROBE_H__
+#define __ROM_PROBE_H__
+
+#include "m64p_types.h"
+#include <QString>
+
+struct rom_identity {
+    QString md5;
+    QString goodname;
+    QString headername;
+    uint32_t crc1 = 0;
+    uint32_t crc2 = 0;
+    unsigned char country_code = 0;
+};
+
+/* Identifies a plain or archived ROM image the same way the core does after
+   M64CMD_ROM_OPEN (MD5 over the big-endian image, goodname from the ROM
+   database) without loading anything into the core. Safe to call from any
+   thread. */
+m64p_error probeROM(const QString &filename, struct rom_identity *identity);
+
+#endif /* __ROM_PROBE_H__ */
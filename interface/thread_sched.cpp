@@ -0,0 +1,189 @@
+#include "thread_sched.h"
+#include "common.h"
+#include "mainwindow.h"
+#include <QHash>
+#include <QMutex>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+static QMutex override_mutex;
+static QHash<QString, QString> overrides;
+
+static const char *priority_names[] = { "idle", "lowest", "low", "normal", "high", "highest", "timecritical" };
+#ifdef __linux__
+/* QThread priorities don't affect SCHED_OTHER threads on Linux, the
+   thread's nice value does */
+static const int priority_nice[] = { 19, 10, 5, 0, -5, -10, -15 };
+#endif
+
+void threadSchedOverride(const QString &key, const QString &value)
+{
+    QMutexLocker locker(&override_mutex);
+    overrides.insert(key, value);
+}
+
+static QString schedValue(QSettings &settings, const QString &key)
+{
+    QMutexLocker locker(&override_mutex);
+    if (overrides.contains(key))
+        return overrides.value(key);
+    return settings.value(key).toString();
+}
+
+/* A list with anything that isn't a CPU number or range in it is ignored
+   as a whole, rather than pinning to whatever toInt() made of it. */
+static QList<int> parseCpus(const char *name, const QString &list)
+{
+    QList<int> cpus;
+    QStringList parts = list.split(",", QString::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i)
+    {
+        QStringList range = parts.at(i).trimmed().split("-");
+        bool first_ok = false;
+        bool last_ok = true;
+        int first = range.at(0).trimmed().toInt(&first_ok);
+        int last = range.size() == 2 ? range.at(1).trimmed().toInt(&last_ok) : first;
+        if (!first_ok || !last_ok || range.size() > 2 || first < 0 || last < first)
+        {
+            DebugMessage(M64MSG_WARNING, "%s: invalid CPU list '%s', affinity left unchanged", name, list.toUtf8().constData());
+            return QList<int>();
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.append(cpu);
+    }
+    return cpus;
+}
+
+static void setAffinity(const char *name, const QList<int> &cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus.at(i) < CPU_SETSIZE)
+            CPU_SET(cpus.at(i), &set);
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+        DebugMessage(M64MSG_WARNING, "%s: couldn't set CPU affinity: %s", name, strerror(ret));
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus.at(i) < (int) sizeof(mask) * 8)
+            mask |= (DWORD_PTR) 1 << cpus.at(i);
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+        DebugMessage(M64MSG_WARNING, "%s: couldn't set CPU affinity (error %lu)", name, GetLastError());
+#else
+    Q_UNUSED(cpus);
+    DebugMessage(M64MSG_WARNING, "%s: CPU affinity is not supported on this platform", name);
+#endif
+}
+
+static void setPriority(const char *name, int priority)
+{
+#if defined(__linux__)
+    pid_t tid = syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, priority_nice[priority]) != 0)
+        DebugMessage(M64MSG_WARNING, "%s: couldn't set priority %s: %s", name, priority_names[priority], strerror(errno));
+#else
+    Q_UNUSED(name);
+    QThread::currentThread()->setPriority((QThread::Priority) priority);
+#endif
+}
+
+static void setPolicy(const char *name, const QString &policy)
+{
+    if (policy != "fifo" && policy != "rr")
+    {
+        DebugMessage(M64MSG_WARNING, "%s: unknown scheduling policy '%s', policy left unchanged", name, policy.toUtf8().constData());
+        return;
+    }
+#if defined(__linux__)
+    int value = policy == "fifo" ? SCHED_FIFO : SCHED_RR;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_min(value);
+    int ret = pthread_setschedparam(pthread_self(), value, &param);
+    if (ret != 0)
+        DebugMessage(M64MSG_WARNING, "%s: couldn't set scheduling policy %s: %s", name, policy.toUtf8().constData(), strerror(ret));
+#else
+    DebugMessage(M64MSG_WARNING, "%s: scheduling policy %s is only supported on Linux", name, policy.toUtf8().constData());
+#endif
+}
+
+static void reportPlacement(const char *name)
+{
+#if defined(__linux__)
+    QStringList cpus;
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.append(QString::number(cpu));
+        }
+    }
+    int policy = SCHED_OTHER;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    const char *policy_name = policy == SCHED_FIFO ? "fifo" : policy == SCHED_RR ? "rr" : "other";
+    int nice = getpriority(PRIO_PROCESS, syscall(SYS_gettid));
+    DebugMessage(M64MSG_INFO, "%s: cpus %s, policy %s (priority %d), nice %d, running on cpu %d", name,
+                 cpus.join(",").toUtf8().constData(), policy_name, param.sched_priority, nice, sched_getcpu());
+#elif defined(_WIN32)
+    DebugMessage(M64MSG_INFO, "%s: priority %d, running on cpu %lu", name,
+                 GetThreadPriority(GetCurrentThread()), GetCurrentProcessorNumber());
+#else
+    DebugMessage(M64MSG_INFO, "%s: priority %s", name, priority_names[QThread::currentThread()->priority() < 7 ? QThread::currentThread()->priority() : 6]);
+#endif
+}
+
+void threadSchedApply(const char *name, const char *prefix)
+{
+    QSettings settings(w->getSettings()->fileName(), QSettings::IniFormat);
+    QString key = prefix;
+
+    QList<int> cpus = parseCpus(name, schedValue(settings, key + "Cpus"));
+    if (!cpus.isEmpty())
+        setAffinity(name, cpus);
+
+    QString priority = schedValue(settings, key + "Priority").toLower();
+    if (!priority.isEmpty())
+    {
+        int level = -1;
+        for (int i = 0; i < 7; ++i)
+        {
+            if (priority == priority_names[i])
+                level = i;
+        }
+        if (level >= 0)
+            setPriority(name, level);
+        else
+            DebugMessage(M64MSG_WARNING, "%s: unknown priority '%s'", name, priority.toUtf8().constData());
+    }
+
+    QString policy = schedValue(settings, key + "Policy").toLower();
+    if (!policy.isEmpty() && policy != "other")
+        setPolicy(name, policy);
+
+    reportPlacement(name);
+}
@@ -0,0 +1,20 @@
+#ifndef __THREAD_SCHED_H__
+#define __THREAD_SCHED_H__
+
+#include <QString>
+
+/* Scheduling settings per thread, keyed by a prefix ("emu", "present"):
+     <prefix>Cpus      CPUs to pin to, e.g. "2,3" or "2-5"; empty leaves it
+     <prefix>Priority  idle, lowest, low, normal, high, highest, timecritical
+     <prefix>Policy    other, fifo or rr (Linux, needs CAP_SYS_NICE or an
+                       RLIMIT_RTPRIO allowance)
+   Single-threaded builds emulate on the GUI thread and ignore the "emu"
+   settings. */
+
+/* Overrides a setting for this run only, used for command line flags. */
+void threadSchedOverride(const QString &key, const QString &value);
+
+/* Applies the settings to the calling thread and logs where it ended up. */
+void threadSchedApply(const char *name, const char *prefix);
+
+#endif /* __THREAD_SCHED_H__ */
@@ -15,6 +15,7 @@ LogViewer::LogViewer(QWidget *parent)
 
 void LogViewer::showEvent(QShowEvent *event)
 {
+    QMutexLocker locker(&mutex);
     file.flush();
 
     qint64 pos = file.pos();
@@ -26,18 +27,21 @@ void LogViewer::showEvent(QShowEvent *event)
         data += "\n";
     }
     file.seek(pos);
+    locker.unlock();
     textArea->setPlainText(data);
     QWidget::showEvent( event );
 }
 
 void LogViewer::addLog(QString text)
 {
+    QMutexLocker locker(&mutex);
     QTextStream out(&file);
     out << text;
 }
 
 void LogViewer::clearLog()
 {
+    QMutexLocker locker(&mutex);
     file.seek(0);
     file.resize(0);
     file.flush();
@@ -6,6 +6,7 @@
 #include <QVBoxLayout>
 #include <QTemporaryFile>
 #include <QTextStream>
+#include <QMutex>
 
 class LogViewer : public QDialog
 {
@@ -18,6 +19,7 @@ protected:
     void showEvent(QShowEvent *event);
 private:
     QTemporaryFile file;
+    QMutex mutex;
     QPlainTextEdit *textArea = nullptr;
 };
 
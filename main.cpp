@@ -1,13 +1,24 @@
 #include "mainwindow.h"
 #include <QApplication>
 #include <QCommandLineParser>
+#include "romlibrary.h"
+#include "startupprofiler.h"
+#include "vidext.h"
+#include "interface/frame_stats.h"
+#include "interface/thread_sched.h"
+#include "interface/log_ring.h"
+#include <QTimer>
+#include <stdio.h>
 
 MainWindow *w = nullptr;
 int main(int argc, char *argv[])
 {
+    StartupProfiler::start();
     srand (time(NULL));
 
+    StartupProfiler::begin("QApplication");
     QApplication a(argc, argv);
+    StartupProfiler::end("QApplication");
 
     QCoreApplication::setApplicationName("mupen64plus-gui");
 
@@ -16,23 +27,86 @@ int main(int argc, char *argv[])
     QCommandLineOption verboseOption({"v", "verbose"}, "Verbose mode. Prints out more information to log.");
     QCommandLineOption noGUIOption("nogui", "Disable GUI elements.");
     QCommandLineOption GLESOption("gles", "Request an OpenGL ES Context.");
+    QCommandLineOption offscreenOption("offscreen", "Run <ROM> rendering into an offscreen framebuffer. No window is shown and the application exits when emulation ends, but OpenGL still needs a display server (e.g. Xvfb on Linux).");
+    QCommandLineOption hashBenchmarkOption("hash-benchmark", "Hash <count> generated ROM images and report throughput, then exit.", "count");
+    QCommandLineOption swapBenchmarkOption("swap-benchmark", "Time <frames> calls of the video extension swap hook on an offscreen context, then exit.", "frames");
+    QCommandLineOption frameStatsOption("frame-stats", "Print frame pacing statistics of the last game at exit.");
+    QCommandLineOption startupProfileOption("startup-profile", "Write a Chrome trace of the startup phases to <file>.", "file");
     parser.addOption(verboseOption);
     parser.addOption(noGUIOption);
     parser.addOption(GLESOption);
+    parser.addOption(offscreenOption);
+    parser.addOption(hashBenchmarkOption);
+    parser.addOption(swapBenchmarkOption);
+    parser.addOption(startupProfileOption);
+    parser.addOption(frameStatsOption);
+    QList<QCommandLineOption> schedOptions = {
+        QCommandLineOption("emu-cpus", "Pin the emulation thread to <cpus>, e.g. 2,3 or 2-5.", "cpus"),
+        QCommandLineOption("emu-priority", "Emulation thread priority: idle, lowest, low, normal, high, highest or timecritical.", "priority"),
+        QCommandLineOption("emu-policy", "Emulation thread scheduling policy on Linux: other, fifo or rr.", "policy"),
+        QCommandLineOption("present-cpus", "Pin the present thread to <cpus>.", "cpus"),
+        QCommandLineOption("present-priority", "Present thread priority.", "priority"),
+        QCommandLineOption("present-policy", "Present thread scheduling policy on Linux.", "policy")
+    };
+    const char *schedKeys[] = { "emuCpus", "emuPriority", "emuPolicy", "presentCpus", "presentPriority", "presentPolicy" };
+    parser.addOptions(schedOptions);
     parser.addPositionalArgument("ROM", QCoreApplication::translate("main", "ROM to open."));
     parser.process(a);
     const QStringList args = parser.positionalArguments();
 
+    if (parser.isSet(hashBenchmarkOption))
+        return RomLibrary::benchmark(parser.value(hashBenchmarkOption).toInt());
+    if (parser.isSet(swapBenchmarkOption))
+        return qtVidExtSwapBenchmark(parser.value(swapBenchmarkOption).toInt());
+    if (parser.isSet(startupProfileOption))
+        StartupProfiler::setOutput(parser.value(startupProfileOption));
+    for (int i = 0; i < schedOptions.size(); ++i)
+    {
+        if (parser.isSet(schedOptions.at(i)))
+            threadSchedOverride(schedKeys[i], parser.value(schedOptions.at(i)));
+    }
+    /* without a window there is nothing to open a ROM from */
+    if (parser.isSet(offscreenOption) && args.isEmpty())
+    {
+        fprintf(stderr, "--offscreen needs a ROM to run\n");
+        return 1;
+    }
+
+    StartupProfiler::begin("MainWindow");
     w = new MainWindow();
-    w->show();
+    StartupProfiler::end("MainWindow");
+    logRingStart();
+    if (!parser.isSet(offscreenOption))
+    {
+        StartupProfiler::begin("show");
+        w->show();
+        StartupProfiler::end("show");
+    }
+    QTimer::singleShot(0, [](){ StartupProfiler::mark("event loop"); });
     if (parser.isSet(verboseOption))
         w->setVerbose();
     if (parser.isSet(noGUIOption))
         w->setNoGUI();
     if (parser.isSet(GLESOption))
         w->setGLES();
+    if (parser.isSet(offscreenOption))
+        w->setOffscreen();
     if (args.size() > 0)
         w->openROM(args.at(0), "", 0, 0);
 
-    return a.exec();
+    int ret = a.exec();
+    logRingStop();
+
+    if (parser.isSet(frameStatsOption))
+    {
+        struct frame_stats stats;
+        frameStatsSession(&stats);
+        printf("frames: %d, %.2f fps (VI %.0f Hz)\n", stats.frames, stats.fps, stats.target_hz);
+        printf("frame time: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", stats.p50, stats.p95, stats.p99);
+        printf("late frames: %d\n", stats.late);
+        printf("swap: avg %.3f ms, max %.3f ms\n", stats.swap_avg, stats.swap_max);
+        printf("queue wait: avg %.3f ms\n", stats.wait_avg);
+    }
+
+    return ret;
 }
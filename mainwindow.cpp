@@ -4,6 +4,12 @@
 #include <QCloseEvent>
 #include <QActionGroup>
 #include <QDesktopServices>
+#include <QStandardPaths>
+#include <QScreen>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QDateTime>
+#include <QRegularExpression>
 #include "settingsdialog.h"
 #include "plugindialog.h"
 #include "mainwindow.h"
@@ -12,6 +18,10 @@
 #include "vidext.h"
 #include "netplay/createroom.h"
 #include "netplay/joinroom.h"
+#include "rombrowser.h"
+#include "startupprofiler.h"
+#include "interface/frame_stats.h"
+#include "interface/frame_capture.h"
 
 #include "osal/osal_preproc.h"
 #include "interface/core_commands.h"
@@ -23,6 +33,9 @@
 
 #define SETTINGS_VER 2
 
+#define FRAME_STATS_INTERVAL 500
+#define FRAME_STATS_FRAMES   120
+
 m64p_video_extension_functions vidExtFunctions = {14,
                                                  qtVidExtFuncInit,
                                                  qtVidExtFuncQuit,
@@ -39,6 +52,95 @@ m64p_video_extension_functions vidExtFunctions = {14,
                                                  qtVidExtFuncResizeWindow,
                                                  qtVidExtFuncGLGetDefaultFramebuffer};
 
+static const struct {
+    m64p_plugin_type type;
+    const char *name;
+    const char *setting;
+    const char *lle;
+} plugin_table[] = {
+    { M64PLUGIN_GFX, "Video", "videoPlugin", "mupen64plus-video-angrylion-plus" },
+    { M64PLUGIN_AUDIO, "Audio", "audioPlugin", nullptr },
+    { M64PLUGIN_INPUT, "Input", "inputPlugin", nullptr },
+    { M64PLUGIN_RSP, "RSP", "rspPlugin", "mupen64plus-rsp-parallel" }
+};
+
+#define PLUGIN_COUNT (sizeof(plugin_table) / sizeof(plugin_table[0]))
+
+struct plugin_load {
+    QString path;
+    m64p_dynlib_handle handle = nullptr;
+    m64p_error res = M64ERR_SUCCESS;
+    bool pending = false;
+    qint64 read_ns = 0;
+    qint64 open_ns = 0;
+};
+
+#define PLUGIN_READ_CHUNK (1024 * 1024)
+
+/* Plugins are opened on a pool of their own, so waiting for them never
+   depends on free threads in the global pool. The extra thread opens the
+   core during the lazy load. */
+static QThreadPool *pluginPool()
+{
+    static QThreadPool *pool = []() {
+        QThreadPool *plugin_pool = new QThreadPool;
+        plugin_pool->setMaxThreadCount(PLUGIN_COUNT + 1);
+        return plugin_pool;
+    }();
+    return pool;
+}
+
+/* Runs on pluginPool(). The dynamic loader serializes the relocation work
+   of concurrent opens, so the file is read through once first: that I/O is
+   what overlaps between plugins on a cold cache. */
+static void openPlugin(struct plugin_load *load)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QFile file(load->path);
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QByteArray chunk(PLUGIN_READ_CHUNK, 0);
+        while (file.read(chunk.data(), PLUGIN_READ_CHUNK) > 0);
+        file.close();
+    }
+    load->read_ns = timer.nsecsElapsed();
+
+    timer.restart();
+    load->res = osal_dynlib_open(&load->handle, load->path.toLatin1().data());
+    load->open_ns = timer.nsecsElapsed();
+}
+
+/* Libraries opened by the lazy load, before CoreStartup and PluginStartup
+   run on the GUI thread. */
+static struct plugin_load core_preload;
+static struct plugin_load plugin_preloads[PLUGIN_COUNT];
+
+/* Hands over a preloaded library if it was opened from the same path. */
+static bool takePreload(struct plugin_load *preload, QString path, struct plugin_load *load)
+{
+    if (!preload->pending || preload->path != path)
+        return false;
+    *load = *preload;
+    preload->handle = nullptr;
+    preload->pending = false;
+    return true;
+}
+
+/* Closes whatever the settings changed away from before it was used. */
+static void closePreloads()
+{
+    if (core_preload.pending && core_preload.res == M64ERR_SUCCESS)
+        osal_dynlib_close(core_preload.handle);
+    core_preload = plugin_load();
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+    {
+        if (plugin_preloads[i].pending && plugin_preloads[i].res == M64ERR_SUCCESS)
+            osal_dynlib_close(plugin_preloads[i].handle);
+        plugin_preloads[i] = plugin_load();
+    }
+}
+
 void MainWindow::updatePlugins()
 {
     QString pluginPath = settings->value("pluginDirPath").toString();
@@ -355,12 +457,14 @@ MainWindow::MainWindow(QWidget *parent) :
     verbose = 0;
     nogui = 0;
     gles = 0;
+    offscreen = 0;
     ui->setupUi(this);
 
     m_title = "mupen64plus-gui    Build Date: ";
     m_title += __DATE__;
     this->setWindowTitle(m_title);
 
+    StartupProfiler::begin("settings");
     QString ini_path = QDir(QCoreApplication::applicationDirPath()).filePath("mupen64plus-gui.ini");
     settings = new QSettings(ini_path, QSettings::IniFormat, this);
 
@@ -375,13 +479,22 @@ MainWindow::MainWindow(QWidget *parent) :
 
     restoreGeometry(settings->value("geometry").toByteArray());
     restoreState(settings->value("windowState").toByteArray());
+    StartupProfiler::end("settings");
 
-    QActionGroup *my_slots_group = new QActionGroup(this);
+    StartupProfiler::begin("menus");
+    my_slots_group = new QActionGroup(this);
     QAction *my_slots[10];
     OpenRecent = new QMenu(this);
     QMenu * SaveSlot = new QMenu(this);
     OpenRecent->setTitle("Open Recent");
     SaveSlot->setTitle("Change Save Slot");
+    QAction *romBrowserAction = new QAction(this);
+    romBrowserAction->setText("ROM Browser");
+    ui->menuFile->insertAction(ui->actionSave_State, romBrowserAction);
+    connect(romBrowserAction, &QAction::triggered,[=](){
+        RomBrowser *romBrowser = new RomBrowser(getRomLibrary(), this);
+        romBrowser->show();
+    });
     ui->menuFile->insertMenu(ui->actionSave_State, OpenRecent);
     ui->menuFile->insertSeparator(ui->actionSave_State);
     ui->menuFile->insertMenu(ui->actionSave_State_To, SaveSlot);
@@ -405,6 +518,7 @@ MainWindow::MainWindow(QWidget *parent) :
     updateGB(ui);
     updateDD(ui);
     updatePIF(ui);
+    StartupProfiler::end("menus");
 
     if (!settings->contains("coreLibPath"))
         settings->setValue("coreLibPath", "$APP_PATH$");
@@ -413,23 +527,210 @@ MainWindow::MainWindow(QWidget *parent) :
     if (!settings->contains("configDirPath"))
         settings->setValue("configDirPath", "$CONFIG_PATH$");
 
+    StartupProfiler::begin("updatePlugins");
     updatePlugins();
+    StartupProfiler::end("updatePlugins");
 
     if (!settings->contains("volume"))
         settings->setValue("volume", 100);
+    if (!settings->contains("mapROM"))
+        settings->setValue("mapROM", 1);
+    if (!settings->contains("romCacheMB"))
+        settings->setValue("romCacheMB", 0);
+    if (!settings->contains("reuseCore"))
+        settings->setValue("reuseCore", 1);
+    if (!settings->contains("lazyCoreLoad"))
+        settings->setValue("lazyCoreLoad", 1);
     VolumeAction * volumeAction = new VolumeAction(tr("Volume"));
     connect(volumeAction->slider(), SIGNAL(valueChanged(int)), this, SLOT(volumeValueChanged(int)));
     volumeAction->slider()->setValue(settings->value("volume").toInt());
     ui->menuEmulation->insertAction(ui->actionMute, volumeAction);
 
+    setupPresentationMenu();
+
+    if (!settings->contains("screenshotBurst"))
+        settings->setValue("screenshotBurst", 10);
+    QAction *burstAction = new QAction(this);
+    burstAction->setText("Take Screenshot Burst");
+    QList<QAction*> file_actions = ui->menuFile->actions();
+    ui->menuFile->insertAction(file_actions.at(file_actions.indexOf(ui->actionTake_Screenshot) + 1), burstAction);
+    connect(burstAction, &QAction::triggered,[=](){
+        takeScreenshots(settings->value("screenshotBurst").toInt());
+    });
+
+    /* the recording queue is the memory ceiling: recordQueueFrames frames
+       at the window's size, dropped when the encoder falls behind */
+    if (!settings->contains("recordDir"))
+        settings->setValue("recordDir", QStandardPaths::writableLocation(QStandardPaths::MoviesLocation));
+    if (!settings->contains("recordQueueFrames"))
+        settings->setValue("recordQueueFrames", 8);
+    QAction *recordAction = new QAction(this);
+    recordAction->setText("Start Recording");
+    ui->menuFile->insertAction(file_actions.at(file_actions.indexOf(ui->actionTake_Screenshot) + 1), recordAction);
+    connect(recordAction, &QAction::triggered, this, &MainWindow::toggleRecording);
+    connect(ui->menuFile, &QMenu::aboutToShow,[=](){
+        recordAction->setText(frameCaptureRecording() ? "Stop Recording" : "Start Recording");
+    });
+
+    setupTurboMenu();
+
+    if (!settings->contains("showFrameStats"))
+        settings->setValue("showFrameStats", 0);
+    QAction *frameStatsAction = new QAction(this);
+    frameStatsAction->setText("Show Frame Stats");
+    frameStatsAction->setCheckable(true);
+    frameStatsAction->setChecked(settings->value("showFrameStats").toInt());
+    ui->menuEmulation->insertAction(ui->actionView_Log, frameStatsAction);
+    frameStatsTimer = new QTimer(this);
+    connect(frameStatsTimer, &QTimer::timeout, this, &MainWindow::updateFrameStats);
+    if (frameStatsAction->isChecked())
+        frameStatsTimer->start(FRAME_STATS_INTERVAL);
+    connect(frameStatsAction, &QAction::toggled,[=](bool checked){
+        settings->setValue("showFrameStats", checked ? 1 : 0);
+        if (checked)
+            frameStatsTimer->start(FRAME_STATS_INTERVAL);
+        else
+        {
+            frameStatsTimer->stop();
+            ui->statusBar->clearMessage();
+        }
+    });
+
     coreLib = nullptr;
     gfxPlugin = nullptr;
     rspPlugin = nullptr;
     audioPlugin = nullptr;
     inputPlugin = nullptr;
+    if (settings->value("lazyCoreLoad").toInt())
+    {
+        /* almost every menu action (and its shortcut) reaches into the core,
+           those stay disabled until the background load is done. Opening a
+           ROM waits for it instead. */
+        coreLoadPending = true;
+        disableCoreActions(QList<QAction*>({ui->actionOpen_ROM, ui->actionExit, ui->actionView_Log,
+                                            ui->actionOpen_Discord_Channel, ui->actionSupport_on_Patreon, romBrowserAction}));
+        QTimer::singleShot(0, this, &MainWindow::startCoreLoad);
+    }
+    else
+    {
+        loadCore();
+        finishCoreLoad();
+    }
+
+    StartupProfiler::begin("setupDiscord");
+    setupDiscord();
+    StartupProfiler::end("setupDiscord");
+
+#ifndef __APPLE__
+    StartupProfiler::begin("update check");
+    QNetworkAccessManager *updateManager = new QNetworkAccessManager(this);
+    connect(updateManager, &QNetworkAccessManager::finished,
+        this, &MainWindow::updateReplyFinished);
+
+    updateManager->get(QNetworkRequest(QUrl("https://api.github.com/repos/loganmc10/m64p/releases/latest")));
+    StartupProfiler::end("update check");
+#endif
+}
+
+MainWindow::~MainWindow()
+{
+    delete ui;
+}
+
+/* Runs right after the window comes up. Only the file reads and dlopen of
+   the libraries happen on the thread pool, the paths are resolved here and
+   CoreStartup and PluginStartup run on the GUI thread once they're open
+   (the Qt input plugin gets this window as its parent). */
+void MainWindow::startCoreLoad()
+{
+    if (!coreLoadPending || coreLoadWatcher != nullptr)
+        return;
+
+    StartupProfiler::mark("core load");
+    core_preload.path = coreFilePath();
+    core_preload.pending = true;
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+    {
+        plugin_preloads[i].path = pluginFilePath(i);
+        plugin_preloads[i].pending = true;
+    }
+
+    coreLoadWatcher = new QFutureWatcher<void>(this);
+    connect(coreLoadWatcher, &QFutureWatcher<void>::finished, this, &MainWindow::ensureCoreLoaded);
+    coreLoadWatcher->setFuture(QtConcurrent::run(pluginPool(), []() {
+        QFuture<void> futures[PLUGIN_COUNT];
+        for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+            futures[i] = QtConcurrent::run(pluginPool(), openPlugin, &plugin_preloads[i]);
+        openPlugin(&core_preload);
+        for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+            futures[i].waitForFinished();
+    }));
+}
+
+void MainWindow::loadCore()
+{
+    StartupProfiler::begin("loadCoreLib");
     loadCoreLib();
+    StartupProfiler::end("loadCoreLib");
+    StartupProfiler::begin("loadPlugins");
     loadPlugins();
+    StartupProfiler::end("loadPlugins");
+}
+
+void MainWindow::waitForCoreLoad()
+{
+    if (coreLoadWatcher == nullptr)
+        return;
+
+    coreLoadWatcher->disconnect(this);
+    coreLoadWatcher->waitForFinished();
+    coreLoadWatcher->deleteLater();
+    coreLoadWatcher = nullptr;
+}
+
+void MainWindow::ensureCoreLoaded()
+{
+    if (!coreLoadPending)
+        return;
+    coreLoadPending = false;
+
+    waitForCoreLoad();
+    loadCore();
+    closePreloads();
 
+    for (int i = 0; i < coreActions.size(); ++i)
+        coreActions.at(i)->setEnabled(true);
+    coreActions.clear();
+    finishCoreLoad();
+}
+
+void MainWindow::disableCoreActions(QList<QAction*> keep)
+{
+    QList<QMenu*> menus({ui->menuFile, ui->menuEmulation, ui->menuSettings, ui->menuNetplay});
+    while (!menus.isEmpty())
+    {
+        QMenu *menu = menus.takeFirst();
+        QList<QAction*> actions = menu->actions();
+        for (int i = 0; i < actions.size(); ++i)
+        {
+            QAction *action = actions.at(i);
+            /* the recent ROMs go through openROM(), which waits for the load */
+            if (action->menu() != nullptr)
+            {
+                if (action->menu() != OpenRecent)
+                    menus.append(action->menu());
+            }
+            else if (!action->isSeparator() && action->isEnabled() && !keep.contains(action))
+            {
+                action->setEnabled(false);
+                coreActions.append(action);
+            }
+        }
+    }
+}
+
+void MainWindow::finishCoreLoad()
+{
     setupLLE();
 
     if (coreLib)
@@ -439,24 +740,148 @@ MainWindow::MainWindow(QWidget *parent) :
         if (res == M64ERR_SUCCESS)
         {
             int current_slot = (*ConfigGetParamInt)(coreConfigHandle, "CurrentStateSlot");
-            my_slots[current_slot]->setChecked(true);
+            my_slots_group->actions().at(current_slot)->setChecked(true);
         }
     }
+}
 
-    setupDiscord();
+/* Presentation options are read when the next game's video starts. Frame
+   Delay only works with vsync on and the present thread off, it is turned
+   off (with a warning in the log) otherwise. */
+void MainWindow::setupPresentationMenu()
+{
+    if (!settings->contains("vsync"))
+        settings->setValue("vsync", -1);
+    if (!settings->contains("frameDelay"))
+        settings->setValue("frameDelay", 0);
+    if (!settings->contains("maxQueuedFrames"))
+        settings->setValue("maxQueuedFrames", 0);
+    if (!settings->contains("presentThread"))
+        settings->setValue("presentThread", 0);
+#ifdef SINGLE_THREAD
+    /* ms per frame the swap hook may spend on GUI events */
+    if (!settings->contains("eventBudget"))
+        settings->setValue("eventBudget", 2);
+#endif
 
-#ifndef __APPLE__
-    QNetworkAccessManager *updateManager = new QNetworkAccessManager(this);
-    connect(updateManager, &QNetworkAccessManager::finished,
-        this, &MainWindow::updateReplyFinished);
+    QMenu *presentation = new QMenu(this);
+    presentation->setTitle("Presentation");
+    ui->menuSettings->insertMenu(ui->actionLLE_Graphics, presentation);
+    ui->menuSettings->insertSeparator(ui->actionLLE_Graphics);
+
+    struct {
+        const char *setting;
+        const char *title;
+        QStringList names;
+        QList<int> values;
+    } options[] = {
+        { "vsync", "VSync", QStringList({"Plugin Default", "Off", "On", "Adaptive"}), QList<int>({-1, 0, 1, 2}) },
+        { "frameDelay", "Frame Delay", QStringList({"Off", "2 ms", "4 ms", "6 ms", "8 ms", "10 ms"}), QList<int>({0, 2, 4, 6, 8, 10}) },
+        { "maxQueuedFrames", "Max Queued Frames", QStringList({"Driver Default", "1", "2", "3"}), QList<int>({0, 1, 2, 3}) },
+        { "presentThread", "Present Thread", QStringList({"Off", "On"}), QList<int>({0, 1}) }
+    };
+
+    for (unsigned int i = 0; i < sizeof(options) / sizeof(options[0]); ++i)
+    {
+        QMenu *menu = presentation->addMenu(options[i].title);
+        QActionGroup *group = new QActionGroup(this);
+        QString setting = options[i].setting;
+        for (int j = 0; j < options[i].names.size(); ++j)
+        {
+            QAction *action = menu->addAction(options[i].names.at(j));
+            action->setCheckable(true);
+            action->setActionGroup(group);
+            int value = options[i].values.at(j);
+            action->setChecked(settings->value(setting).toInt() == value);
+            connect(action, &QAction::triggered,[=](){
+                settings->setValue(setting, value);
+            });
+            /* adaptive needs EXT_swap_control_tear, which takes a GL context
+               to check for, so that waits until the menu is first opened */
+            if (setting == "vsync" && value == 2)
+            {
+                action->setVisible(false);
+                connect(menu, &QMenu::aboutToShow,[=](){
+                    action->setVisible(qtVidExtAdaptiveVsyncSupported());
+                });
+            }
+        }
+    }
+}
 
-    updateManager->get(QNetworkRequest(QUrl("https://api.github.com/repos/loganmc10/m64p/releases/latest")));
-#endif
+/* Turbo runs the core at turboSpeed percent (0 lifts the speed limit) and
+   presents at most one frame per display refresh. It is switched off when
+   the game's video shuts down. */
+void MainWindow::setupTurboMenu()
+{
+    if (!settings->contains("turboSpeed"))
+        settings->setValue("turboSpeed", 300);
+
+    QList<QAction*> emulation_actions = ui->menuEmulation->actions();
+    QAction *before = emulation_actions.at(emulation_actions.indexOf(ui->actionToggle_Speed_Limiter) + 1);
+    turboAction = new QAction(this);
+    turboAction->setText("Turbo");
+    turboAction->setCheckable(true);
+    ui->menuEmulation->insertAction(before, turboAction);
+    connect(turboAction, &QAction::triggered, this, &MainWindow::setTurbo);
+
+    QMenu *speedMenu = new QMenu(this);
+    speedMenu->setTitle("Turbo Speed");
+    ui->menuEmulation->insertMenu(before, speedMenu);
+    QActionGroup *group = new QActionGroup(this);
+    QStringList names({"200%", "300%", "500%", "Unlimited"});
+    QList<int> values({200, 300, 500, 0});
+    for (int i = 0; i < names.size(); ++i)
+    {
+        QAction *action = speedMenu->addAction(names.at(i));
+        action->setCheckable(true);
+        action->setActionGroup(group);
+        int value = values.at(i);
+        action->setChecked(settings->value("turboSpeed").toInt() == value);
+        connect(action, &QAction::triggered,[=](){
+            settings->setValue("turboSpeed", value);
+            if (turboAction->isChecked())
+                setTurbo(true);
+        });
+    }
 }
 
-MainWindow::~MainWindow()
+void MainWindow::setTurbo(bool enabled)
 {
-    delete ui;
+    if (coreLib == nullptr)
+        return;
+
+    int state = M64EMU_STOPPED;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &state);
+    if (state == M64EMU_STOPPED)
+    {
+        enabled = false;
+        turboAction->setChecked(false);
+    }
+
+    /* the speed the user had set is put back when turbo ends */
+    if (enabled && !turboActive)
+    {
+        (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_SPEED_FACTOR, &turboSavedFactor);
+        (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_SPEED_LIMITER, &turboSavedLimiter);
+    }
+    if (enabled || turboActive)
+    {
+        int speed = settings->value("turboSpeed").toInt();
+        int factor = enabled && speed ? speed : turboSavedFactor;
+        int limiter = enabled ? speed != 0 : turboSavedLimiter;
+        (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_SPEED_FACTOR, &factor);
+        (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_SPEED_LIMITER, &limiter);
+    }
+    turboActive = enabled;
+
+    int interval_us = 0;
+    if (enabled)
+    {
+        QScreen *screen = windowHandle() ? windowHandle()->screen() : QGuiApplication::primaryScreen();
+        interval_us = 1000000 / qMax(screen->refreshRate(), (qreal) 1);
+    }
+    qtVidExtSetPresentInterval(interval_us);
 }
 
 void MainWindow::setupLLE()
@@ -488,7 +913,7 @@ void MainWindow::setupLLE()
             int response;
             (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &response);
             if (response == M64EMU_STOPPED)
-                resetCore();
+                refreshCore();
         }
     });
 
@@ -615,6 +1040,23 @@ void MainWindow::updateReplyFinished(QNetworkReply *reply)
     reply->deleteLater();
 }
 
+void MainWindow::updateFrameStats()
+{
+    struct frame_stats stats;
+    frameStatsRecent(&stats, FRAME_STATS_FRAMES);
+    if (stats.frames == 0 || workerThread == nullptr || !workerThread->isRunning())
+    {
+        ui->statusBar->clearMessage();
+        return;
+    }
+
+    ui->statusBar->showMessage(QString("%1 fps (VI %2 Hz) | frame p50 %3 p95 %4 p99 %5 ms | late %6 | swap %7 ms, max %8 ms | queue wait %9 ms")
+                               .arg(stats.fps, 0, 'f', 1).arg(stats.target_hz, 0, 'f', 0)
+                               .arg(stats.p50, 0, 'f', 1).arg(stats.p95, 0, 'f', 1).arg(stats.p99, 0, 'f', 1)
+                               .arg(stats.late).arg(stats.swap_avg, 0, 'f', 2).arg(stats.swap_max, 0, 'f', 2)
+                               .arg(stats.wait_avg, 0, 'f', 2));
+}
+
 void MainWindow::volumeValueChanged(int value)
 {
     if (value != settings->value("volume").toInt())
@@ -658,6 +1100,16 @@ int MainWindow::getGLES()
     return gles;
 }
 
+void MainWindow::setOffscreen()
+{
+    offscreen = 1;
+}
+
+int MainWindow::getOffscreen()
+{
+    return offscreen;
+}
+
 void MainWindow::resizeMainWindow(int Width, int Height)
 {
     QSize size = this->size();
@@ -688,14 +1140,16 @@ void MainWindow::toggleFS(int force)
     }
 }
 
-void MainWindow::findRecursion(const QString &path, const QString &pattern, QStringList *result)
+void MainWindow::moveToScreen(int index)
 {
-    QDir currentDir(path);
-    const QString prefix = path + QLatin1Char('/');
-    foreach (const QString &match, currentDir.entryList(QStringList(pattern), QDir::Files))
-        result->append(prefix + match);
-    foreach (const QString &dir, currentDir.entryList(QDir::Dirs | QDir::NoSymLinks | QDir::NoDotAndDotDot))
-        findRecursion(prefix + dir, pattern, result);
+    QList<QScreen *> screens = QGuiApplication::screens();
+    if (index < 0 || index >= screens.size())
+        return;
+
+    QRect target = screens.at(index)->availableGeometry();
+    QRect frame = frameGeometry();
+    frame.moveCenter(target.center());
+    move(frame.topLeft());
 }
 
 void MainWindow::closeEvent (QCloseEvent *event)
@@ -715,6 +1169,17 @@ void MainWindow::closeEvent (QCloseEvent *event)
 
     stopGame();
 
+    /* no frame was ever presented, write what was recorded so far */
+    StartupProfiler::finish();
+
+    /* the background load has to be done before the libraries can be closed */
+    waitForCoreLoad();
+    closePreloads();
+    coreLoadPending = false;
+
+    if (romLibrary)
+        romLibrary->stop();
+
     closePlugins();
     closeCoreLib();
 
@@ -789,8 +1254,26 @@ void MainWindow::createOGLWindow(QSurfaceFormat* format)
     this->installEventFilter(&keyPressFilter);
 }
 
+void MainWindow::createOffscreenSurface(QSurfaceFormat* format)
+{
+    my_surface = new QOffscreenSurface();
+    my_surface->setFormat(*format);
+    my_surface->create();
+}
+
 void MainWindow::deleteOGLWindow()
 {
+    if (turboAction->isChecked())
+    {
+        turboAction->setChecked(false);
+        setTurbo(false);
+    }
+
+    delete my_surface;
+    my_surface = nullptr;
+    if (offscreen)
+        return;
+
     QWidget *container = new QWidget(this);
     my_window->doneCurrent();
     setCentralWidget(container);
@@ -814,12 +1297,44 @@ void MainWindow::stopGame()
 
 void MainWindow::resetCore()
 {
+    if (coreLoadPending)
+    {
+        ensureCoreLoaded();
+        return;
+    }
+
     closePlugins();
     closeCoreLib();
     loadCoreLib();
     loadPlugins();
 }
 
+/* Keeps the core and any plugin whose file is unchanged loaded between games,
+   only libraries whose path (or the LLE toggle) changed are reloaded. */
+void MainWindow::refreshCore()
+{
+    if (coreLoadPending)
+    {
+        ensureCoreLoaded();
+        return;
+    }
+
+    if (!settings->value("reuseCore").toInt() || coreLib == nullptr ||
+        loadedCorePath != coreFilePath() || loadedConfigDir != settings->value("configDirPath").toString())
+    {
+        resetCore();
+        return;
+    }
+
+    (*ConfigSaveFile)();
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+    {
+        if (loadedPluginPaths.value(plugin_table[i].type) != pluginFilePath(i))
+            closePlugin(i);
+    }
+    loadPlugins();
+}
+
 #ifdef SINGLE_THREAD
 void MainWindow::singleThreadLaunch(QString filename, QString netplay_ip, int netplay_port, int netplay_player)
 {
@@ -829,6 +1344,8 @@ void MainWindow::singleThreadLaunch(QString filename, QString netplay_ip, int ne
 
 void MainWindow::openROM(QString filename, QString netplay_ip, int netplay_port, int netplay_player)
 {
+    ensureCoreLoaded();
+
 #ifdef SINGLE_THREAD
     int response;
     (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &response);
@@ -845,7 +1362,7 @@ void MainWindow::openROM(QString filename, QString netplay_ip, int netplay_port,
 
     logViewer.clearLog();
 
-    resetCore();
+    refreshCore();
 
     workerThread = new WorkerThread(netplay_ip, netplay_port, netplay_player, this);
     workerThread->setFileName(filename);
@@ -860,6 +1377,7 @@ void MainWindow::openROM(QString filename, QString netplay_ip, int netplay_port,
     settings->setValue("RecentROMs",list.join(";"));
     updateOpenRecent();
 
+    qtVidExtUpdateScreens(windowHandle() ? windowHandle()->screen() : nullptr);
     workerThread->start();
 }
 
@@ -939,9 +1457,60 @@ void MainWindow::on_actionSoft_Reset_triggered()
     (*CoreDoCommand)(M64CMD_RESET, 0, NULL);
 }
 
+/* Screenshots go where the core would put them, recordings to recordDir.
+   Both are read back and encoded by the frontend so they don't stall
+   emulation. */
+QString MainWindow::captureBase(QString dir)
+{
+    QDir().mkpath(dir);
+    QString name = "mupen64plus";
+    m64p_rom_settings rom_settings;
+    if ((*CoreDoCommand)(M64CMD_ROM_GET_SETTINGS, sizeof(rom_settings), &rom_settings) == M64ERR_SUCCESS && rom_settings.goodname[0])
+        name = QString(rom_settings.goodname).replace(QRegularExpression("[^A-Za-z0-9 ._()-]"), "_");
+    return QDir(dir).filePath(name + "-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+}
+
+void MainWindow::takeScreenshots(int count)
+{
+    int state = M64EMU_STOPPED;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &state);
+    if (state == M64EMU_STOPPED || count <= 0)
+        return;
+
+    QString dir;
+    m64p_handle coreConfigHandle;
+    if ((*ConfigOpenSection)("Core", &coreConfigHandle) == M64ERR_SUCCESS)
+    {
+        const char *path = (*ConfigGetParamString)(coreConfigHandle, "ScreenshotPath");
+        if (path)
+            dir = path;
+    }
+    if (dir.isEmpty())
+        dir = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    frameCaptureScreenshot(count, captureBase(dir));
+}
+
+void MainWindow::toggleRecording()
+{
+    if (frameCaptureRecording())
+    {
+        frameCaptureRecordStop();
+        return;
+    }
+
+    int state = M64EMU_STOPPED;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &state);
+    if (state == M64EMU_STOPPED)
+        return;
+
+    QString filename = captureBase(settings->value("recordDir").toString()) + ".y4m";
+    if (!frameCaptureRecordStart(filename, qRound(frameStatsTargetHz()), settings->value("recordQueueFrames").toInt()))
+        showMessage("Couldn't start recording to " + filename);
+}
+
 void MainWindow::on_actionTake_Screenshot_triggered()
 {
-    (*CoreDoCommand)(M64CMD_TAKE_NEXT_SCREENSHOT, 0, NULL);
+    takeScreenshots(1);
 }
 
 void MainWindow::on_actionSave_State_triggered()
@@ -1055,6 +1624,11 @@ OGLWindow* MainWindow::getOGLWindow()
     return my_window;
 }
 
+QOffscreenSurface* MainWindow::getOffscreenSurface()
+{
+    return my_surface;
+}
+
 QSettings* MainWindow::getSettings()
 {
     return settings;
@@ -1065,6 +1639,31 @@ LogViewer* MainWindow::getLogViewer()
     return &logViewer;
 }
 
+RomLibrary* MainWindow::getRomLibrary()
+{
+    if (romLibrary == nullptr)
+    {
+        QString indexDir;
+        if (settings->format() == QSettings::IniFormat)
+            indexDir = QFileInfo(settings->fileName()).absolutePath();
+        else
+            indexDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(indexDir);
+
+        romLibrary = new RomLibrary(QDir(indexDir).filePath("mupen64plus-gui-library.dat"), this);
+        if (settings->contains("libraryDirs"))
+            romLibrary->setDirectories(settings->value("libraryDirs").toString().split(";"));
+        connect(romLibrary, &RomLibrary::scanProgress, this, [=](int done, int total){
+            if (done < total)
+                ui->statusBar->showMessage(QString("Hashing ROMs: %1 / %2").arg(done).arg(total));
+            else
+                ui->statusBar->showMessage(QString("ROM library: hashed %1 ROMs").arg(total), 5000);
+        });
+        romLibrary->start(QThread::LowPriority);
+    }
+    return romLibrary;
+}
+
 m64p_dynlib_handle MainWindow::getAudioPlugin()
 {
     return audioPlugin;
@@ -1098,10 +1697,16 @@ void MainWindow::closeCoreLib()
 
 void MainWindow::loadCoreLib()
 {
-    QString corePath = settings->value("coreLibPath").toString();
-    corePath.replace("$APP_PATH$", QCoreApplication::applicationDirPath());
-
-    m64p_error res = osal_dynlib_open(&coreLib, QDir(corePath).filePath(OSAL_DEFAULT_DYNLIB_FILENAME).toLatin1().data());
+    QString core_path = coreFilePath();
+    struct plugin_load load;
+    m64p_error res;
+    if (takePreload(&core_preload, core_path, &load))
+    {
+        coreLib = load.handle;
+        res = load.res;
+    }
+    else
+        res = osal_dynlib_open(&coreLib, core_path.toLatin1().data());
 
     if (res != M64ERR_SUCCESS)
     {
@@ -1141,112 +1746,127 @@ void MainWindow::loadCoreLib()
         (*CoreStartup)(CORE_API_VERSION, NULL /*Config dir*/, QCoreApplication::applicationDirPath().toLatin1().data(), (char*)"Core", DebugCallback, NULL, NULL);
 
     CoreOverrideVidExt(&vidExtFunctions);
+
+    loadedCorePath = core_path;
+    loadedConfigDir = settings->value("configDirPath").toString();
 }
 
-void MainWindow::closePlugins()
+m64p_dynlib_handle* MainWindow::pluginHandle(m64p_plugin_type type)
 {
-    ptr_PluginShutdown PluginShutdown;
-
-    if (gfxPlugin != nullptr)
+    switch (type)
     {
-        PluginShutdown = (ptr_PluginShutdown) osal_dynlib_getproc(gfxPlugin, "PluginShutdown");
-        (*PluginShutdown)();
-        osal_dynlib_close(gfxPlugin);
-        gfxPlugin = nullptr;
+        case M64PLUGIN_GFX:
+            return &gfxPlugin;
+        case M64PLUGIN_AUDIO:
+            return &audioPlugin;
+        case M64PLUGIN_INPUT:
+            return &inputPlugin;
+        case M64PLUGIN_RSP:
+            return &rspPlugin;
+        default:
+            return nullptr;
     }
-    if (audioPlugin != nullptr)
-    {
-        PluginShutdown = (ptr_PluginShutdown) osal_dynlib_getproc(audioPlugin, "PluginShutdown");
-        (*PluginShutdown)();
-        osal_dynlib_close(audioPlugin);
-        audioPlugin = nullptr;
-    }
-    if (inputPlugin != nullptr)
-    {
-        PluginShutdown = (ptr_PluginShutdown) osal_dynlib_getproc(inputPlugin, "PluginShutdown");
-        (*PluginShutdown)();
-        osal_dynlib_close(inputPlugin);
-        inputPlugin = nullptr;
-    }
-    if (rspPlugin != nullptr)
+}
+
+QString MainWindow::pluginFilePath(unsigned int index)
+{
+    QString pluginPath = settings->value("pluginDirPath").toString();
+    pluginPath.replace("$APP_PATH$", QCoreApplication::applicationDirPath());
+
+    if (plugin_table[index].lle && settings->value("LLE").toInt())
+        return QDir(pluginPath).filePath(QString(plugin_table[index].lle) + OSAL_DLL_EXTENSION);
+    return QDir(pluginPath).filePath(settings->value(plugin_table[index].setting).toString());
+}
+
+QString MainWindow::coreFilePath()
+{
+    QString corePath = settings->value("coreLibPath").toString();
+    corePath.replace("$APP_PATH$", QCoreApplication::applicationDirPath());
+    return QDir(corePath).filePath(OSAL_DEFAULT_DYNLIB_FILENAME);
+}
+
+void MainWindow::closePlugin(unsigned int index)
+{
+    m64p_dynlib_handle *handle = pluginHandle(plugin_table[index].type);
+    if (*handle != nullptr)
     {
-        PluginShutdown = (ptr_PluginShutdown) osal_dynlib_getproc(rspPlugin, "PluginShutdown");
+        ptr_PluginShutdown PluginShutdown = (ptr_PluginShutdown) osal_dynlib_getproc(*handle, "PluginShutdown");
         (*PluginShutdown)();
-        osal_dynlib_close(rspPlugin);
-        rspPlugin = nullptr;
+        osal_dynlib_close(*handle);
+        *handle = nullptr;
     }
+    loadedPluginPaths.remove(plugin_table[index].type);
 }
 
+void MainWindow::closePlugins()
+{
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+        closePlugin(i);
+}
+
+/* Only opens the plugins that aren't loaded yet, so refreshCore() can keep
+   the ones whose path didn't change. The libraries are opened in parallel
+   (or taken from the lazy load), PluginStartup then runs here in the usual
+   video, audio, input, RSP order. */
 void MainWindow::loadPlugins()
 {
     if (coreLib == nullptr)
         return;
 
-    ptr_PluginStartup PluginStartup;
-    m64p_error res;
-    QMessageBox msgBox;
-
-    QString pluginPath = settings->value("pluginDirPath").toString();
-    pluginPath.replace("$APP_PATH$", QCoreApplication::applicationDirPath());
+    QElapsedTimer total;
+    total.start();
 
-    QString lle_path;
-    QString plugin_path;
-    if (settings->value("LLE").toInt())
-    {
-        lle_path = "mupen64plus-video-angrylion-plus";
-        lle_path += OSAL_DLL_EXTENSION;
-        plugin_path = QDir(pluginPath).filePath(lle_path);
-    }
-    else
-        plugin_path = QDir(pluginPath).filePath(settings->value("videoPlugin").toString());
-    res = osal_dynlib_open(&gfxPlugin, plugin_path.toLatin1().data());
-    if (res != M64ERR_SUCCESS)
+    struct plugin_load loads[PLUGIN_COUNT];
+    QFuture<void> futures[PLUGIN_COUNT];
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
     {
-        msgBox.setText("Failed to load video plugin");
-        msgBox.exec();
-        return;
-    }
-    PluginStartup = (ptr_PluginStartup) osal_dynlib_getproc(gfxPlugin, "PluginStartup");
-    (*PluginStartup)(coreLib, (char*)"Video", DebugCallback);
-    res = osal_dynlib_open(&audioPlugin, QDir(pluginPath).filePath(settings->value("audioPlugin").toString()).toLatin1().data());
-    if (res != M64ERR_SUCCESS)
-    {
-        msgBox.setText("Failed to load audio plugin");
-        msgBox.exec();
-        return;
-    }
-    PluginStartup = (ptr_PluginStartup) osal_dynlib_getproc(audioPlugin, "PluginStartup");
-    (*PluginStartup)(coreLib, (char*)"Audio", DebugCallback);
-    res = osal_dynlib_open(&inputPlugin, QDir(pluginPath).filePath(settings->value("inputPlugin").toString()).toLatin1().data());
-    if (res != M64ERR_SUCCESS)
-    {
-        msgBox.setText("Failed to load input plugin");
-        msgBox.exec();
-        return;
+        if (*pluginHandle(plugin_table[i].type) != nullptr)
+            continue;
+        QString path = pluginFilePath(i);
+        if (takePreload(&plugin_preloads[i], path, &loads[i]))
+            continue;
+        loads[i].path = path;
+        loads[i].pending = true;
+        futures[i] = QtConcurrent::run(pluginPool(), openPlugin, &loads[i]);
     }
-    PluginStartup = (ptr_PluginStartup) osal_dynlib_getproc(inputPlugin, "PluginStartup");
-    if (settings->value("inputPlugin").toString().contains("-qt"))
-        (*PluginStartup)(coreLib, this, nullptr);
-    else
-        (*PluginStartup)(coreLib, (char*)"Input", DebugCallback);
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
+        futures[i].waitForFinished();
 
-    if (settings->value("LLE").toInt())
-    {
-        lle_path = "mupen64plus-rsp-parallel";
-        lle_path += OSAL_DLL_EXTENSION;
-        plugin_path = QDir(pluginPath).filePath(lle_path);
-    }
-    else
-        plugin_path = QDir(pluginPath).filePath(settings->value("rspPlugin").toString());
-    res = osal_dynlib_open(&rspPlugin, plugin_path.toLatin1().data());
-    if (res != M64ERR_SUCCESS)
+    for (unsigned int i = 0; i < PLUGIN_COUNT; ++i)
     {
-        msgBox.setText("Failed to load rsp plugin");
-        msgBox.exec();
-        return;
+        if (!loads[i].pending)
+            continue;
+
+        if (loads[i].res != M64ERR_SUCCESS)
+        {
+            for (unsigned int j = i + 1; j < PLUGIN_COUNT; ++j)
+            {
+                if (loads[j].pending && loads[j].res == M64ERR_SUCCESS)
+                    osal_dynlib_close(loads[j].handle);
+            }
+            QMessageBox msgBox;
+            msgBox.setText(QString("Failed to load %1 plugin").arg(QString(plugin_table[i].name).toLower()));
+            msgBox.exec();
+            return;
+        }
+
+        m64p_dynlib_handle *handle = pluginHandle(plugin_table[i].type);
+        *handle = loads[i].handle;
+
+        QElapsedTimer timer;
+        timer.start();
+        ptr_PluginStartup PluginStartup = (ptr_PluginStartup) osal_dynlib_getproc(*handle, "PluginStartup");
+        if (plugin_table[i].type == M64PLUGIN_INPUT && settings->value("inputPlugin").toString().contains("-qt"))
+            (*PluginStartup)(coreLib, this, nullptr);
+        else
+            (*PluginStartup)(coreLib, (char*)plugin_table[i].name, DebugCallback);
+        loadedPluginPaths.insert(plugin_table[i].type, loads[i].path);
+
+        DebugMessage(M64MSG_INFO, "%s plugin: read %.1f ms, open %.1f ms, startup %.1f ms (%s)", plugin_table[i].name,
+                     loads[i].read_ns / 1000000.0, loads[i].open_ns / 1000000.0, timer.nsecsElapsed() / 1000000.0,
+                     loads[i].path.toUtf8().constData());
     }
-    PluginStartup = (ptr_PluginStartup) osal_dynlib_getproc(rspPlugin, "PluginStartup");
-    (*PluginStartup)(coreLib, (char*)"RSP", DebugCallback);
+    DebugMessage(M64MSG_INFO, "plugins loaded in %.1f ms", total.nsecsElapsed() / 1000000.0);
 }
 
 m64p_dynlib_handle MainWindow::getCoreLib()
@@ -6,6 +6,7 @@
 #include "workerthread.h"
 #include "logviewer.h"
 #include "keypressfilter.h"
+#include "romlibrary.h"
 extern "C" {
 #include "osal/osal_dynamiclib.h"
 }
@@ -16,6 +17,11 @@ extern "C" {
 #include <QSlider>
 #include <QLabel>
 #include <QNetworkReply>
+#include <QHash>
+#include <QActionGroup>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QOffscreenSurface>
 
 namespace Ui {
 class MainWindow;
@@ -34,8 +40,10 @@ class MainWindow : public QMainWindow
 public:
     WorkerThread* getWorkerThread();
     OGLWindow* getOGLWindow();
+    QOffscreenSurface* getOffscreenSurface();
     QSettings* getSettings();
     LogViewer* getLogViewer();
+    RomLibrary* getRomLibrary();
 
     m64p_dynlib_handle getAudioPlugin();
     m64p_dynlib_handle getRspPlugin();
@@ -52,8 +60,12 @@ public:
     int getNoGUI();
     void setGLES();
     int getGLES();
+    void setOffscreen();
+    int getOffscreen();
     void updatePlugins();
     void resetCore();
+    void refreshCore();
+    void ensureCoreLoaded();
     QThread *getRenderingThread();
     void setRenderingThread(QThread* thread);
     m64p_dynlib_handle getCoreLib();
@@ -67,7 +79,9 @@ protected:
 public slots:
     void resizeMainWindow(int Width, int Height);
     void toggleFS(int force);
+    void moveToScreen(int index);
     void createOGLWindow(QSurfaceFormat* format);
+    void createOffscreenSurface(QSurfaceFormat* format);
     void deleteOGLWindow();
     void showMessage(QString message);
     void updateDiscordActivity(struct DiscordActivity activity);
@@ -82,6 +96,8 @@ private slots:
 
     void volumeValueChanged(int value);
 
+    void updateFrameStats();
+
     void on_actionOpen_ROM_triggered();
 
     void on_actionPlugin_Paths_triggered();
@@ -130,6 +146,17 @@ private slots:
 
 private:
     void setupLLE();
+    void setupPresentationMenu();
+    void setupTurboMenu();
+    void setTurbo(bool enabled);
+    QString captureBase(QString dir);
+    void takeScreenshots(int count);
+    void toggleRecording();
+    void startCoreLoad();
+    void loadCore();
+    void waitForCoreLoad();
+    void finishCoreLoad();
+    void disableCoreActions(QList<QAction*> keep);
     void setupDiscord();
     void stopGame();
     void updateOpenRecent();
@@ -140,19 +167,27 @@ private:
     void loadPlugins();
     void closeCoreLib();
     void closePlugins();
-    void findRecursion(const QString &path, const QString &pattern, QStringList *result);
+    void closePlugin(unsigned int index);
+    m64p_dynlib_handle* pluginHandle(m64p_plugin_type type);
+    QString pluginFilePath(unsigned int index);
+    QString coreFilePath();
     Ui::MainWindow *ui;
     QMenu * OpenRecent;
+    QActionGroup *my_slots_group;
+    QAction *turboAction;
     int verbose;
     int nogui;
     int gles;
+    int offscreen;
     QString m_title;
 
     OGLWindow *my_window = nullptr;
+    QOffscreenSurface *my_surface = nullptr;
     QThread *rendering_thread = nullptr;
     WorkerThread *workerThread = nullptr;
     LogViewer logViewer;
     QSettings *settings = nullptr;
+    RomLibrary *romLibrary = nullptr;
     KeyPressFilter keyPressFilter;
 
     m64p_dynlib_handle coreLib;
@@ -160,6 +195,16 @@ private:
     m64p_dynlib_handle audioPlugin;
     m64p_dynlib_handle gfxPlugin;
     m64p_dynlib_handle inputPlugin;
+    QString loadedCorePath;
+    QString loadedConfigDir;
+    QHash<int, QString> loadedPluginPaths;
+    bool coreLoadPending = false;
+    bool turboActive = false;
+    int turboSavedFactor = 100;
+    int turboSavedLimiter = 1;
+    QTimer *frameStatsTimer;
+    QFutureWatcher<void> *coreLoadWatcher = nullptr;
+    QList<QAction*> coreActions;
 
     struct Discord_Application discord_app;
 };
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += widgets websockets
+QT       += widgets websockets concurrent
 
 TARGET = mupen64plus-gui
 TEMPLATE = app
@@ -26,11 +26,22 @@ SOURCES += main.cpp \
     plugindialog.cpp \
     oglwindow.cpp \
     workerthread.cpp \
+    presentthread.cpp \
     settingclasses.cpp \
     interface/core_commands.cpp \
+    interface/rom_archive.cpp \
+    interface/rom_probe.cpp \
+    interface/rom_cache.cpp \
+    interface/frame_stats.cpp \
+    interface/frame_capture.cpp \
+    interface/thread_sched.cpp \
+    interface/log_ring.cpp \
     interface/sdl_key_converter.c \
     logviewer.cpp \
     keypressfilter.cpp \
+    romlibrary.cpp \
+    startupprofiler.cpp \
+    rombrowser.cpp \
     netplay/createroom.cpp \
     netplay/joinroom.cpp \
     netplay/waitroom.cpp
@@ -47,14 +58,17 @@ SOURCES += osal/osal_dynamiclib_win32.c \
         !contains(QMAKE_TARGET.arch, x86_64) {
             message("x86 build")
             LIBS += ../mupen64plus-win32-deps/SDL2-2.0.6/lib/x86/SDL2.lib
+            LIBS += ../mupen64plus-win32-deps/zlib-1.2.11/lib/x86/zlib.lib
         } else {
             message("x86_64 build")
             LIBS += ../mupen64plus-win32-deps/SDL2-2.0.6/lib/x64/SDL2.lib
+            LIBS += ../mupen64plus-win32-deps/zlib-1.2.11/lib/x64/zlib.lib
         }
         INCLUDEPATH += ../mupen64plus-win32-deps/SDL2-2.0.6/include
+        INCLUDEPATH += ../mupen64plus-win32-deps/zlib-1.2.11/include
     } else {
         DEFINES -= UNICODE
-        LIBS += -Wl,-Bdynamic -lSDL2
+        LIBS += -Wl,-Bdynamic -lSDL2 -lz
         INCLUDEPATH += /mingw64/include/SDL2 /mingw32/include/SDL2
     }
 }
@@ -72,8 +86,16 @@ INCLUDEPATH += /usr/local/include /usr/include/SDL2 /usr/local/include/SDL2
 HEADERS  += mainwindow.h \
     vidext.h \
     interface/common.h \
+    interface/rom_archive.h \
+    interface/rom_probe.h \
+    interface/rom_cache.h \
+    interface/frame_stats.h \
+    interface/frame_capture.h \
+    interface/thread_sched.h \
+    interface/log_ring.h \
     settingsdialog.h \
     workerthread.h \
+    presentthread.h \
     plugindialog.h \
     oglwindow.h \
     settingclasses.h \
@@ -81,6 +103,9 @@ HEADERS  += mainwindow.h \
     interface/sdl_key_converter.h \
     logviewer.h \
     keypressfilter.h \
+    romlibrary.h \
+    startupprofiler.h \
+    rombrowser.h \
     netplay/createroom.h \
     netplay/joinroom.h \
     netplay/waitroom.h \
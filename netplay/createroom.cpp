@@ -2,7 +2,6 @@
 #include "createroom.h"
 #include "waitroom.h"
 #include "version.h"
-#include "interface/core_commands.h"
 #include <QGridLayout>
 #include <QLabel>
 #include <QCheckBox>
@@ -12,6 +11,7 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QInputDialog>
+#include <QtConcurrent>
 
 CreateRoom::CreateRoom(QWidget *parent)
     : QDialog(parent)
@@ -106,7 +106,6 @@ void CreateRoom::processBroadcast()
 void CreateRoom::onFinished(int)
 {
     broadcastSocket.close();
-    (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
     if (!launched && webSocket)
     {
         disconnect(webSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(handleConnectionError(QAbstractSocket::SocketError)));
@@ -146,34 +145,52 @@ void CreateRoom::handleCreateButton()
         msgBox.exec();
         return;
     }
-    if (loadROM(romButton->text().toStdString()) == M64ERR_SUCCESS)
-    {
-        createButton->setEnabled(false);
-        if (webSocket)
-        {
-            webSocket->close();
-            webSocket->deleteLater();
-        }
-        webSocket = new QWebSocket;
-        (*CoreDoCommand)(M64CMD_ROM_GET_SETTINGS, sizeof(rom_settings), &rom_settings);
-        connect(webSocket, &QWebSocket::connected, this, &CreateRoom::onConnected);
-        connect(webSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(handleConnectionError(QAbstractSocket::SocketError)));
-        QString serverAddress = serverChooser->currentData() == "Custom" ? customServerHost.prepend("ws://") : serverChooser->currentData().toString();
-        QUrl serverUrl = QUrl(serverAddress);
-        if (serverChooser->currentData() == "Custom" && serverUrl.port() < 0)
-            // Be forgiving of custom server addresses that forget the port
-            serverUrl.setPort(45000);
-        connectionTimer = new QTimer(this);
-        connectionTimer->setSingleShot(true);
-        connectionTimer->start(1000);
-        connect(connectionTimer, SIGNAL(timeout()), this, SLOT(connectionFailed()));
-        webSocket->open(serverUrl);
-    }
-    else
+    /* identify the ROM off the GUI thread, the core is not involved until the game starts */
+    QString romPath = romButton->text();
+    QFutureWatcher<struct rom_identity> *watcher = new QFutureWatcher<struct rom_identity>(this);
+    connect(watcher, &QFutureWatcher<struct rom_identity>::finished, [=]() {
+        createProbedRoom(watcher->result());
+        watcher->deleteLater();
+    });
+    createButton->setEnabled(false);
+    watcher->setFuture(QtConcurrent::run([romPath]() {
+        struct rom_identity identity;
+        if (probeROM(romPath, &identity) != M64ERR_SUCCESS)
+            identity.md5.clear();
+        return identity;
+    }));
+}
+
+void CreateRoom::createProbedRoom(struct rom_identity identity)
+{
+    if (identity.md5.isEmpty())
     {
+        createButton->setEnabled(true);
+        QMessageBox msgBox;
         msgBox.setText("Could not open ROM");
         msgBox.exec();
+        return;
+    }
+
+    rom_info = identity;
+    if (webSocket)
+    {
+        webSocket->close();
+        webSocket->deleteLater();
     }
+    webSocket = new QWebSocket;
+    connect(webSocket, &QWebSocket::connected, this, &CreateRoom::onConnected);
+    connect(webSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(handleConnectionError(QAbstractSocket::SocketError)));
+    QString serverAddress = serverChooser->currentData() == "Custom" ? customServerHost.prepend("ws://") : serverChooser->currentData().toString();
+    QUrl serverUrl = QUrl(serverAddress);
+    if (serverChooser->currentData() == "Custom" && serverUrl.port() < 0)
+        // Be forgiving of custom server addresses that forget the port
+        serverUrl.setPort(45000);
+    connectionTimer = new QTimer(this);
+    connectionTimer->setSingleShot(true);
+    connectionTimer->start(1000);
+    connect(connectionTimer, SIGNAL(timeout()), this, SLOT(connectionFailed()));
+    webSocket->open(serverUrl);
 }
 
 void CreateRoom::onConnected()
@@ -187,8 +204,8 @@ void CreateRoom::onConnected()
     json.insert("room_name", nameEdit->text());
     json.insert("player_name", playerNameEdit->text());
     json.insert("password", passwordEdit->text());
-    json.insert("MD5", QString(rom_settings.MD5));
-    json.insert("game_name", QString(rom_settings.goodname));
+    json.insert("MD5", rom_info.md5);
+    json.insert("game_name", rom_info.goodname);
     json.insert("client_sha", QStringLiteral(GUI_VERSION));
     json.insert("netplay_version", NETPLAY_VER);
     json.insert("lle", w->getSettings()->value("LLE").toInt() ? "Yes" : "No");
@@ -262,7 +279,6 @@ void CreateRoom::handleConnectionError(QAbstractSocket::SocketError error)
 void CreateRoom::connectionFailed()
 {
     disconnect(webSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(handleConnectionError(QAbstractSocket::SocketError)));
-    (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
     QMessageBox msgBox;
     msgBox.setText("Could not connect to netplay server.");
     msgBox.exec();
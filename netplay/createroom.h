@@ -7,7 +7,7 @@
 #include <QWebSocket>
 #include <QComboBox>
 #include <QtNetwork>
-#include "interface/common.h"
+#include "interface/rom_probe.h"
 
 class CreateRoom : public QDialog
 {
@@ -27,12 +27,13 @@ private slots:
     void handleConnectionError(QAbstractSocket::SocketError error);
     void connectionFailed();
 private:
+    void createProbedRoom(struct rom_identity identity);
     QPushButton *romButton;
     QPushButton *createButton;
     QWebSocket *webSocket = nullptr;
     QNetworkAccessManager manager;
     QComboBox *serverChooser;
-    m64p_rom_settings rom_settings;
+    struct rom_identity rom_info;
     QLineEdit *nameEdit;
     QLineEdit *passwordEdit;
     QLineEdit *playerNameEdit;
@@ -1,7 +1,6 @@
 #include "joinroom.h"
 #include "waitroom.h"
 #include "mainwindow.h"
-#include "interface/core_commands.h"
 #include "version.h"
 #include <QGridLayout>
 #include <QLabel>
@@ -11,6 +10,7 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QInputDialog>
+#include <QtConcurrent>
 
 JoinRoom::JoinRoom(QWidget *parent)
     : QDialog(parent)
@@ -93,7 +93,6 @@ void JoinRoom::processBroadcast()
 void JoinRoom::onFinished(int)
 {
     broadcastSocket.close();
-    (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
     if (!launched && webSocket)
     {
         webSocket->close();
@@ -158,55 +157,68 @@ void JoinRoom::joinGame()
     tr("Open ROM"), w->getSettings()->value("ROMdir").toString(), tr("ROM Files (*.n64 *.N64 *.z64 *.Z64 *.v64 *.V64 *.zip *.ZIP *.7z)"));
     if (!filename.isNull())
     {
-        if (loadROM(filename.toStdString()) == M64ERR_SUCCESS)
-        {
-            QJsonObject json = rooms.at(listWidget->currentRow());
-            m64p_rom_settings rom_settings;
-            (*CoreDoCommand)(M64CMD_ROM_GET_SETTINGS, sizeof(rom_settings), &rom_settings);
-            bool roomRequiresInputDelay = json.contains("use_input_delay") && json.value("use_input_delay").toBool();
-            if (QString(rom_settings.MD5) != json.value("MD5").toString())
-            {
-                (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
-                msgBox.setText("ROM does not match room ROM");
-                msgBox.exec();
-            }
-            else if (json.value("lle").toString() == "Yes" && w->getSettings()->value("LLE").toInt() != 1)
-            {
-                (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
-                msgBox.setText("You must enable LLE graphics");
-                msgBox.exec();
-            }
-            else if (json.value("lle").toString() == "No" && w->getSettings()->value("LLE").toInt() != 0)
-            {
-                (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
-                msgBox.setText("You must disable LLE graphics");
-                msgBox.exec();
-            }
-            else if (roomRequiresInputDelay && inputDelay->text().isEmpty())
-            {
-                (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
-                msgBox.setText("You must specify input delay to join this room");
-                msgBox.exec();
-            }
-            else
-            {
-                json.insert("type", "join_room");
-                json.insert("player_name", playerName->text());
-                json.insert("password", passwordEdit->text());
-                json.insert("client_sha", QStringLiteral(GUI_VERSION));
-                if (roomRequiresInputDelay)
-                    json.insert("input_delay", inputDelay->text().toInt());
-                else
-                    json.remove("input_delay");
-                QJsonDocument json_doc(json);
-                webSocket->sendBinaryMessage(json_doc.toJson());
-            }
-        }
+        /* identify the ROM off the GUI thread, the core is not involved until the game starts */
+        QJsonObject room = rooms.at(listWidget->currentRow());
+        QString romPath = filename;
+        QFutureWatcher<struct rom_identity> *watcher = new QFutureWatcher<struct rom_identity>(this);
+        connect(watcher, &QFutureWatcher<struct rom_identity>::finished, [=]() {
+            joinButton->setEnabled(true);
+            joinProbedGame(watcher->result(), room);
+            watcher->deleteLater();
+        });
+        joinButton->setEnabled(false);
+        watcher->setFuture(QtConcurrent::run([romPath]() {
+            struct rom_identity identity;
+            if (probeROM(romPath, &identity) != M64ERR_SUCCESS)
+                identity.md5.clear();
+            return identity;
+        }));
+    }
+}
+
+void JoinRoom::joinProbedGame(struct rom_identity identity, QJsonObject json)
+{
+    QMessageBox msgBox;
+    if (identity.md5.isEmpty())
+    {
+        msgBox.setText("Could not open ROM");
+        msgBox.exec();
+        return;
+    }
+
+    bool roomRequiresInputDelay = json.contains("use_input_delay") && json.value("use_input_delay").toBool();
+    if (identity.md5 != json.value("MD5").toString())
+    {
+        msgBox.setText("ROM does not match room ROM");
+        msgBox.exec();
+    }
+    else if (json.value("lle").toString() == "Yes" && w->getSettings()->value("LLE").toInt() != 1)
+    {
+        msgBox.setText("You must enable LLE graphics");
+        msgBox.exec();
+    }
+    else if (json.value("lle").toString() == "No" && w->getSettings()->value("LLE").toInt() != 0)
+    {
+        msgBox.setText("You must disable LLE graphics");
+        msgBox.exec();
+    }
+    else if (roomRequiresInputDelay && inputDelay->text().isEmpty())
+    {
+        msgBox.setText("You must specify input delay to join this room");
+        msgBox.exec();
+    }
+    else if (webSocket)
+    {
+        json.insert("type", "join_room");
+        json.insert("player_name", playerName->text());
+        json.insert("password", passwordEdit->text());
+        json.insert("client_sha", QStringLiteral(GUI_VERSION));
+        if (roomRequiresInputDelay)
+            json.insert("input_delay", inputDelay->text().toInt());
         else
-        {
-            msgBox.setText("Could not open ROM");
-            msgBox.exec();
-        }
+            json.remove("input_delay");
+        QJsonDocument json_doc(json);
+        webSocket->sendBinaryMessage(json_doc.toJson());
     }
 }
 
@@ -332,31 +344,26 @@ void JoinRoom::processBinaryMessage(QByteArray message)
         }
         else if (json.value("accept").toInt() == 1)
         {
-            (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
             msgBox.setText("Bad password");
             msgBox.exec();
         }
         else if (json.value("accept").toInt() == 2)
         {
-            (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
             msgBox.setText("Client versions do not match");
             msgBox.exec();
         }
         else if (json.value("accept").toInt() == 3)
         {
-            (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
             msgBox.setText("Room is full");
             msgBox.exec();
         }
         else if (json.value("accept").toInt() == 4)
         {
-            (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
             msgBox.setText("Player name is already taken");
             msgBox.exec();
         }
         else
         {
-            (*CoreDoCommand)(M64CMD_ROM_CLOSE, 0, NULL);
             msgBox.setText("Could not join room");
             msgBox.exec();
         }
@@ -8,6 +8,7 @@
 #include <QWebSocket>
 #include <QLineEdit>
 #include <QPushButton>
+#include "interface/rom_probe.h"
 
 class JoinRoom : public QDialog
 {
@@ -26,6 +27,7 @@ private slots:
     void connectionFailed();
 private:
     void resetList();
+    void joinProbedGame(struct rom_identity identity, QJsonObject json);
     QComboBox *serverChooser;
     QNetworkAccessManager manager;
     QTableWidget *listWidget;
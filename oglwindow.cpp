@@ -1,35 +1,36 @@
 
 #include "oglwindow.h"
 #include "mainwindow.h"
-#include "interface/core_commands.h"
+#include "vidext.h"
+#include <QElapsedTimer>
 
 void OGLWindow::initializeGL() {
     doneCurrent();
 #ifndef SINGLE_THREAD
     context()->moveToThread(w->getRenderingThread());
 #endif
+    contextMutex.lock();
+    contextMoved = true;
+    contextReady.wakeAll();
+    contextMutex.unlock();
 }
 
-void OGLWindow::resizeEvent(QResizeEvent *event) {
-    QOpenGLWindow::resizeEvent(event);
-    if (timerId) {
-        killTimer(timerId);
-        timerId = 0;
+/* Called on the rendering thread, blocks until initializeGL() has handed the
+   context over. Returns false if that didn't happen within timeout ms. */
+bool OGLWindow::waitForContext(int timeout) {
+    QElapsedTimer timer;
+    timer.start();
+    QMutexLocker locker(&contextMutex);
+    while (!contextMoved) {
+        qint64 remaining = timeout - timer.elapsed();
+        if (remaining <= 0 || !contextReady.wait(&contextMutex, remaining))
+            return contextMoved;
     }
-    timerId = startTimer(500);
-    m_width = event->size().width() * devicePixelRatio();
-    m_height = event->size().height() * devicePixelRatio();
+    return true;
 }
 
-void OGLWindow::timerEvent(QTimerEvent *te) {
-    int size = (m_width << 16) + m_height;
-    int current_size = 0;
-
-    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_VIDEO_SIZE, &current_size);
-    if (current_size != size)
-        (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_VIDEO_SIZE, &size);
-
-    killTimer(te->timerId());
-    timerId = 0;
+void OGLWindow::resizeEvent(QResizeEvent *event) {
+    QOpenGLWindow::resizeEvent(event);
+    qtVidExtResize(event->size().width() * devicePixelRatio(), event->size().height() * devicePixelRatio());
     requestActivate();
 }
@@ -4,21 +4,24 @@
 #include <QCloseEvent>
 #include <QOpenGLWindow>
 #include <QOpenGLFunctions>
+#include <QMutex>
+#include <QWaitCondition>
 #include "common.h"
 
 class OGLWindow : public QOpenGLWindow
 {
+public:
+    bool waitForContext(int timeout);
+
 protected:
     void exposeEvent(QExposeEvent *) Q_DECL_OVERRIDE {}
 
     void initializeGL() Q_DECL_OVERRIDE;
 
     void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
-
-    void timerEvent(QTimerEvent *te) Q_DECL_OVERRIDE;
 private:
-    int m_width;
-    int m_height;
-    int timerId = 0;
+    QMutex contextMutex;
+    QWaitCondition contextReady;
+    bool contextMoved = false;
 };
 #endif // OGLWINDOW_H
@@ -0,0 +1,158 @@
+#include "presentthread.h"
+#include "interface/thread_sched.h"
+#include <QCoreApplication>
+#include <QOpenGLFunctions>
+
+#define GL_READ_FRAMEBUFFER           0x8CA8
+#define GL_DRAW_FRAMEBUFFER           0x8CA9
+#define GL_READ_FRAMEBUFFER_BINDING   0x8CAA
+#define GL_DRAW_FRAMEBUFFER_BINDING   0x8CA6
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_TIMEOUT_IGNORED            0xFFFFFFFFFFFFFFFFull
+
+PresentThread::PresentThread(QWindow *window, QOpenGLContext *context)
+{
+    m_window = window;
+    m_context = context;
+}
+
+bool PresentThread::setup(QOpenGLContext *render_context, QSize size)
+{
+    FenceSync = (ptr_glFenceSync) render_context->getProcAddress("glFenceSync");
+    WaitSync = (ptr_glWaitSync) render_context->getProcAddress("glWaitSync");
+    DeleteSync = (ptr_glDeleteSync) render_context->getProcAddress("glDeleteSync");
+    BlitFramebuffer = (ptr_glBlitFramebuffer) render_context->getProcAddress("glBlitFramebuffer");
+    if (!FenceSync || !WaitSync || !DeleteSync || !BlitFramebuffer)
+        return false;
+
+    m_render = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+    m_render->bind();
+    m_context->moveToThread(this);
+    start();
+    return true;
+}
+
+GLuint PresentThread::framebuffer()
+{
+    return m_render->handle();
+}
+
+QSize PresentThread::size()
+{
+    return m_render->size();
+}
+
+void PresentThread::submit(QSize size)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    struct present_buffer *buffer = &m_buffers[m_rendering];
+    if (buffer->presented) {
+        WaitSync(buffer->presented, 0, GL_TIMEOUT_IGNORED);
+        DeleteSync(buffer->presented);
+        buffer->presented = nullptr;
+    }
+    if (buffer->fbo == nullptr || buffer->fbo->size() != m_render->size()) {
+        delete buffer->fbo;
+        buffer->fbo = new QOpenGLFramebufferObject(m_render->size());
+    }
+
+    GLint read = 0;
+    GLint draw = 0;
+    f->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read);
+    f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw);
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, m_render->handle());
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, buffer->fbo->handle());
+    int width = m_render->width();
+    int height = m_render->height();
+    BlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+    f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw);
+    buffer->drawn = FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    f->glFlush();
+
+    m_mutex.lock();
+    if (m_ready >= 0) {
+        DeleteSync(m_buffers[m_ready].drawn);
+        m_buffers[m_ready].drawn = nullptr;
+    }
+    m_ready = m_rendering;
+    for (int i = 0; i < PRESENT_BUFFERS; ++i) {
+        if (i != m_ready && i != m_presenting) {
+            m_rendering = i;
+            break;
+        }
+    }
+    m_wake.wakeOne();
+    m_mutex.unlock();
+
+    /* the window was resized: the plugin draws the next frame at the new size */
+    if (size != m_render->size() && !size.isEmpty()) {
+        bool bound = read == (GLint) m_render->handle() || draw == (GLint) m_render->handle();
+        delete m_render;
+        m_render = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+        if (bound)
+            m_render->bind();
+    }
+}
+
+void PresentThread::stop()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_wake.wakeOne();
+    m_mutex.unlock();
+    wait();
+
+    for (int i = 0; i < PRESENT_BUFFERS; ++i) {
+        if (m_buffers[i].drawn)
+            DeleteSync(m_buffers[i].drawn);
+        if (m_buffers[i].presented)
+            DeleteSync(m_buffers[i].presented);
+        delete m_buffers[i].fbo;
+        m_buffers[i] = present_buffer();
+    }
+    delete m_render;
+    m_render = nullptr;
+}
+
+void PresentThread::run()
+{
+    threadSchedApply("present thread", "present");
+    m_context->makeCurrent(m_window);
+    QOpenGLFunctions *f = m_context->functions();
+    GLuint read_fbo = 0;
+    f->glGenFramebuffers(1, &read_fbo);
+
+    m_mutex.lock();
+    for (;;) {
+        while (m_ready < 0 && !m_stopping)
+            m_wake.wait(&m_mutex);
+        if (m_stopping)
+            break;
+        m_presenting = m_ready;
+        m_ready = -1;
+        struct present_buffer *buffer = &m_buffers[m_presenting];
+        m_mutex.unlock();
+
+        WaitSync(buffer->drawn, 0, GL_TIMEOUT_IGNORED);
+        DeleteSync(buffer->drawn);
+        buffer->drawn = nullptr;
+
+        QSize source = buffer->fbo->size();
+        QSize target = m_window->size() * m_window->devicePixelRatio();
+        f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+        f->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffer->fbo->texture(), 0);
+        f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_context->defaultFramebufferObject());
+        BlitFramebuffer(0, 0, source.width(), source.height(), 0, 0, target.width(), target.height(), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        buffer->presented = FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_context->swapBuffers(m_window);
+
+        m_mutex.lock();
+        m_presenting = -1;
+    }
+    m_mutex.unlock();
+
+    f->glDeleteFramebuffers(1, &read_fbo);
+    m_context->doneCurrent();
+    m_context->moveToThread(QCoreApplication::instance()->thread());
+}
@@ -0,0 +1,68 @@
+#ifndef PRESENTTHREAD_H
+#define PRESENTTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QWindow>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#define PRESENT_BUFFERS 3
+
+typedef void *(QOPENGLF_APIENTRYP ptr_glFenceSync)(GLenum condition, GLbitfield flags);
+typedef void (QOPENGLF_APIENTRYP ptr_glWaitSync)(void *sync, GLbitfield flags, quint64 timeout);
+typedef void (QOPENGLF_APIENTRYP ptr_glDeleteSync)(void *sync);
+typedef void (QOPENGLF_APIENTRYP ptr_glBlitFramebuffer)(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+                                                         GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1,
+                                                         GLbitfield mask, GLenum filter);
+
+/* Swaps the window on its own thread, so vsync waits and compositor stalls
+   stay off the emulation thread. The plugin draws into framebuffer() with a
+   context shared with the window's; submit() copies the frame into a free
+   buffer and hands it over. The present thread always shows the newest
+   buffer, older unpresented ones are recycled. */
+class PresentThread : public QThread
+{
+public:
+    PresentThread(QWindow *window, QOpenGLContext *context);
+
+    /* The methods below are called on the rendering thread with its own
+       context current. setup() moves the window's context to the present
+       thread; it returns false if the driver lacks sync objects or blits. */
+    bool setup(QOpenGLContext *render_context, QSize size);
+    GLuint framebuffer();
+    QSize size();
+    void submit(QSize size);
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    struct present_buffer {
+        QOpenGLFramebufferObject *fbo = nullptr;
+        /* signalled when the frame has been copied in */
+        void *drawn = nullptr;
+        /* signalled when the present thread is done reading it */
+        void *presented = nullptr;
+    };
+
+    QWindow *m_window;
+    QOpenGLContext *m_context;
+    QOpenGLFramebufferObject *m_render = nullptr;
+    struct present_buffer m_buffers[PRESENT_BUFFERS];
+    int m_rendering = 0;
+    int m_ready = -1;
+    int m_presenting = -1;
+    bool m_stopping = false;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+
+    ptr_glFenceSync FenceSync = nullptr;
+    ptr_glWaitSync WaitSync = nullptr;
+    ptr_glDeleteSync DeleteSync = nullptr;
+    ptr_glBlitFramebuffer BlitFramebuffer = nullptr;
+};
+
+#endif // PRESENTTHREAD_H
@@ -0,0 +1,180 @@
+#include "rombrowser.h"
+#include "mainwindow.h"
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QFileInfo>
+
+RomBrowser::RomBrowser(RomLibrary *library, QWidget *parent)
+    : QDialog(parent)
+{
+    m_library = library;
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle("ROM Browser");
+    setMinimumWidth(900);
+    setMinimumHeight(500);
+    QGridLayout *layout = new QGridLayout(this);
+
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText("Filter");
+    connect(filterEdit, SIGNAL(textChanged(QString)), this, SLOT(filterList(QString)));
+    layout->addWidget(filterEdit, 0, 0);
+
+    QPushButton *addButton = new QPushButton("Add Directory", this);
+    addButton->setAutoDefault(false);
+    connect(addButton, SIGNAL(released()), this, SLOT(handleAddButton()));
+    layout->addWidget(addButton, 0, 1);
+
+    QPushButton *clearButton = new QPushButton("Clear Directories", this);
+    clearButton->setAutoDefault(false);
+    connect(clearButton, SIGNAL(released()), this, SLOT(handleClearButton()));
+    layout->addWidget(clearButton, 0, 2);
+
+    QPushButton *rescanButton = new QPushButton("Rescan", this);
+    rescanButton->setAutoDefault(false);
+    connect(rescanButton, SIGNAL(released()), this, SLOT(handleRescanButton()));
+    layout->addWidget(rescanButton, 0, 3);
+
+    listWidget = new QTableWidget(this);
+    listWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
+    listWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listWidget->setColumnCount(4);
+    QStringList headers;
+    headers.append("Game Name");
+    headers.append("CRC");
+    headers.append("MD5");
+    headers.append("File");
+    listWidget->setHorizontalHeaderLabels(headers);
+    listWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    listWidget->horizontalHeader()->setStretchLastSection(true);
+    listWidget->verticalHeader()->hide();
+    connect(listWidget, SIGNAL(cellDoubleClicked(int,int)), this, SLOT(launchRow(int,int)));
+    layout->addWidget(listWidget, 1, 0, 1, 4);
+
+    setLayout(layout);
+
+    listWidget->setSortingEnabled(true);
+    listWidget->sortByColumn(0, Qt::AscendingOrder);
+    connect(m_library, SIGNAL(libraryChanged()), this, SLOT(refreshList()));
+    refreshList();
+    m_library->refresh();
+}
+
+static QString entryName(const RomEntry &entry)
+{
+    return entry.goodname.isEmpty() ? QFileInfo(entry.path).fileName() : entry.goodname;
+}
+
+void RomBrowser::setRow(int row, const RomEntry &entry)
+{
+    QString crc = entry.md5.isEmpty() ? QString() : QString("%1 %2").arg(entry.crc1, 8, 16, QChar('0')).arg(entry.crc2, 8, 16, QChar('0')).toUpper();
+    QStringList columns({entryName(entry), crc, entry.md5, entry.path});
+    for (int i = 0; i < columns.size(); ++i)
+    {
+        QTableWidgetItem *item = listWidget->item(row, i);
+        if (item == nullptr)
+        {
+            item = new QTableWidgetItem(columns.at(i));
+            if (i == 0)
+                item->setData(Qt::UserRole, entry.path);
+            listWidget->setItem(row, i, item);
+        }
+        else if (item->text() != columns.at(i))
+            item->setText(columns.at(i));
+    }
+    listWidget->item(row, 0)->setData(Qt::UserRole + 1, entry.md5);
+}
+
+/* Called on every libraryChanged() tick while a scan runs, so only the rows
+   that were added, removed or hashed since the last one are touched. */
+void RomBrowser::refreshList()
+{
+    QList<RomEntry> entries = m_library->getEntries();
+    QString text = filterEdit->text();
+    bool sorting = listWidget->isSortingEnabled();
+
+    QHash<QString, QTableWidgetItem*> rows;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const RomEntry &entry = entries.at(i);
+        QTableWidgetItem *item = m_rows.take(entry.path);
+        if (item != nullptr && item->text() == entryName(entry) && item->data(Qt::UserRole + 1).toString() == entry.md5)
+        {
+            rows.insert(entry.path, item);
+            continue;
+        }
+
+        /* rows would move on every change otherwise */
+        listWidget->setSortingEnabled(false);
+        int row;
+        if (item == nullptr)
+        {
+            row = listWidget->rowCount();
+            listWidget->insertRow(row);
+        }
+        else
+            row = item->row();
+        setRow(row, entry);
+        filterRow(row, text);
+        rows.insert(entry.path, listWidget->item(row, 0));
+    }
+    /* what is left isn't in the library anymore */
+    for (QHash<QString, QTableWidgetItem*>::const_iterator gone = m_rows.constBegin(); gone != m_rows.constEnd(); ++gone)
+        listWidget->removeRow(gone.value()->row());
+    m_rows = rows;
+    listWidget->setSortingEnabled(sorting);
+}
+
+void RomBrowser::filterRow(int row, QString text)
+{
+    bool match = text.isEmpty() || listWidget->item(row, 0)->text().contains(text, Qt::CaseInsensitive) ||
+                 listWidget->item(row, 3)->text().contains(text, Qt::CaseInsensitive);
+    listWidget->setRowHidden(row, !match);
+}
+
+void RomBrowser::filterList(QString text)
+{
+    for (int i = 0; i < listWidget->rowCount(); ++i)
+        filterRow(i, text);
+}
+
+void RomBrowser::launchRow(int row, int)
+{
+    QString filename = listWidget->item(row, 0)->data(Qt::UserRole).toString();
+#ifndef SINGLE_THREAD
+    w->openROM(filename, "", 0, 0);
+#else
+    w->singleThreadLaunch(filename, "", 0, 0);
+#endif
+    close();
+}
+
+void RomBrowser::handleAddButton()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Add ROM Directory"),
+                                                    w->getSettings()->value("ROMdir").toString(),
+                                                    QFileDialog::ShowDirsOnly);
+    if (dir.isNull())
+        return;
+
+    QStringList dirs;
+    if (w->getSettings()->contains("libraryDirs"))
+        dirs = w->getSettings()->value("libraryDirs").toString().split(";");
+    if (!dirs.contains(dir))
+        dirs.append(dir);
+    w->getSettings()->setValue("libraryDirs", dirs.join(";"));
+    m_library->setDirectories(dirs);
+    m_library->rescan();
+}
+
+void RomBrowser::handleClearButton()
+{
+    w->getSettings()->remove("libraryDirs");
+    m_library->setDirectories(QStringList());
+    m_library->rescan();
+}
+
+void RomBrowser::handleRescanButton()
+{
+    m_library->rescan();
+}
@@ -0,0 +1,33 @@
+#ifndef ROMBROWSER_H
+#define ROMBROWSER_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QHash>
+#include <QTableWidget>
+#include "romlibrary.h"
+
+class RomBrowser : public QDialog
+{
+    Q_OBJECT
+public:
+    RomBrowser(RomLibrary *library, QWidget *parent = nullptr);
+private slots:
+    void refreshList();
+    void filterList(QString text);
+    void launchRow(int row, int column);
+    void handleAddButton();
+    void handleClearButton();
+    void handleRescanButton();
+private:
+    void setRow(int row, const RomEntry &entry);
+    void filterRow(int row, QString text);
+    RomLibrary *m_library;
+    QLineEdit *filterEdit;
+    QTableWidget *listWidget;
+    /* first column's item of every row, by path */
+    QHash<QString, QTableWidgetItem*> m_rows;
+};
+
+#endif // ROMBROWSER_H
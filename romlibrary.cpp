@@ -0,0 +1,367 @@
+#include "romlibrary.h"
+#include "interface/rom_probe.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+#include <stdio.h>
+
+#define LIBRARY_INDEX_MAGIC   0x6D363449
+#define LIBRARY_INDEX_VERSION 2
+#define LIBRARY_NOTIFY_MS     500
+#define LIBRARY_PROGRESS_MS   100
+#define BENCHMARK_ROM_SIZE    (16 * 1024 * 1024)
+
+RomLibrary::RomLibrary(QString indexPath, QObject *parent)
+    : QThread(parent)
+{
+    m_indexPath = indexPath;
+}
+
+void RomLibrary::setDirectories(QStringList dirs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dirs = dirs;
+}
+
+void RomLibrary::rescan()
+{
+    QMutexLocker locker(&m_mutex);
+    m_rescan = true;
+    m_wake.wakeAll();
+}
+
+/* Only rescans if a library directory changed since the last scan. Adding,
+   removing or renaming a ROM changes its directory's mtime; a file that is
+   rewritten in place needs an explicit rescan(). */
+void RomLibrary::refresh()
+{
+    QMutexLocker locker(&m_mutex);
+    m_refresh = true;
+    m_wake.wakeAll();
+}
+
+void RomLibrary::stop()
+{
+    requestInterruption();
+    m_mutex.lock();
+    m_wake.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+QList<RomEntry> RomLibrary::getEntries()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.values();
+}
+
+void RomLibrary::run()
+{
+    loadIndex();
+    emit libraryChanged();
+
+    QMutexLocker locker(&m_mutex);
+    while (!isInterruptionRequested())
+    {
+        if (!m_rescan && !m_refresh)
+        {
+            m_wake.wait(&m_mutex);
+            continue;
+        }
+        bool force = m_rescan;
+        m_rescan = false;
+        m_refresh = false;
+        QStringList dirs = m_dirs;
+        locker.unlock();
+        if (force || directoriesChanged(dirs))
+            scan(dirs);
+        locker.relock();
+    }
+}
+
+void RomLibrary::probeEntry(RomEntry &entry)
+{
+    struct rom_identity identity;
+    if (probeROM(entry.path, &identity) == M64ERR_SUCCESS)
+    {
+        entry.crc1 = identity.crc1;
+        entry.crc2 = identity.crc2;
+        entry.md5 = identity.md5;
+        entry.goodname = identity.goodname;
+    }
+}
+
+/* Files are spread over the pool one per worker; each worker streams its file
+   in large sequential chunks, so the pool keeps both the disk and the cores busy. */
+void RomLibrary::hashEntries(QVector<RomEntry> &pending)
+{
+    QElapsedTimer notify;
+    notify.start();
+
+    QAtomicInt done;
+    for (int i = 0; i < pending.size(); ++i)
+    {
+        RomEntry *entry = &pending[i];
+        QtConcurrent::run(&m_pool, [this, entry, &done]() {
+            probeEntry(*entry);
+            m_mutex.lock();
+            m_entries.insert(entry->path, *entry);
+            m_mutex.unlock();
+            done.ref();
+        });
+    }
+
+    while (!m_pool.waitForDone(LIBRARY_PROGRESS_MS))
+    {
+        if (isInterruptionRequested())
+        {
+            /* drop the files no worker has picked up yet */
+            m_pool.clear();
+            m_pool.waitForDone();
+            break;
+        }
+        emit scanProgress(done.load(), pending.size());
+        if (notify.elapsed() > LIBRARY_NOTIFY_MS)
+        {
+            emit libraryChanged();
+            notify.restart();
+        }
+    }
+    emit scanProgress(done.load(), pending.size());
+}
+
+bool RomLibrary::directoriesChanged(QStringList dirs)
+{
+    m_mutex.lock();
+    QHash<QString, qint64> times = m_dirTimes;
+    m_mutex.unlock();
+
+    for (int i = 0; i < dirs.size(); ++i)
+    {
+        if (!times.contains(dirs.at(i)))
+            return true;
+    }
+    for (QHash<QString, qint64>::const_iterator dir = times.constBegin(); dir != times.constEnd(); ++dir)
+    {
+        QFileInfo info(dir.key());
+        if (!info.exists() || info.lastModified().toMSecsSinceEpoch() != dir.value())
+            return true;
+    }
+    return false;
+}
+
+void RomLibrary::scan(QStringList dirs)
+{
+    QStringList filters;
+    filters << "*.n64" << "*.z64" << "*.v64" << "*.zip" << "*.7z";
+
+    QSet<QString> seen;
+    QStringList unavailable;
+    QVector<RomEntry> pending;
+    QHash<QString, qint64> times;
+    bool dirty = false;
+
+    for (int i = 0; i < dirs.size(); ++i)
+    {
+        /* an unreachable share should not wipe its entries from the index */
+        if (!QDir(dirs.at(i)).exists())
+        {
+            unavailable << QDir(dirs.at(i)).absolutePath() + "/";
+            continue;
+        }
+
+        times.insert(dirs.at(i), QFileInfo(dirs.at(i)).lastModified().toMSecsSinceEpoch());
+        /* the directories are listed too, refresh() compares their mtimes */
+        QDirIterator it(dirs.at(i), filters, QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            if (isInterruptionRequested())
+                return;
+
+            QString path = it.next();
+            QFileInfo info = it.fileInfo();
+            qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+            if (info.isDir())
+            {
+                times.insert(path, mtime);
+                continue;
+            }
+            seen.insert(path);
+
+            m_mutex.lock();
+            QHash<QString, RomEntry>::const_iterator found = m_entries.constFind(path);
+            bool unchanged = found != m_entries.constEnd() && found->size == info.size() && found->mtime == mtime;
+            m_mutex.unlock();
+            if (unchanged)
+                continue;
+
+            RomEntry entry;
+            entry.path = path;
+            entry.size = info.size();
+            entry.mtime = mtime;
+            pending.append(entry);
+        }
+    }
+
+    if (!pending.isEmpty())
+    {
+        hashEntries(pending);
+        dirty = true;
+        if (isInterruptionRequested())
+        {
+            saveIndex();
+            return;
+        }
+    }
+
+    m_mutex.lock();
+    QHash<QString, RomEntry>::iterator entry = m_entries.begin();
+    while (entry != m_entries.end())
+    {
+        bool keep = seen.contains(entry.key());
+        for (int i = 0; !keep && i < unavailable.size(); ++i)
+            keep = entry.key().startsWith(unavailable.at(i));
+        if (keep)
+            ++entry;
+        else
+        {
+            entry = m_entries.erase(entry);
+            dirty = true;
+        }
+    }
+    if (m_dirTimes != times)
+    {
+        m_dirTimes = times;
+        dirty = true;
+    }
+    m_mutex.unlock();
+
+    if (dirty)
+    {
+        saveIndex();
+        emit libraryChanged();
+    }
+}
+
+void RomLibrary::loadIndex()
+{
+    QFile file(m_indexPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    /* version 1 has no directory times, its first refresh() scans */
+    if (magic != LIBRARY_INDEX_MAGIC || version < 1 || version > LIBRARY_INDEX_VERSION)
+        return;
+
+    QHash<QString, RomEntry> entries;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        RomEntry entry;
+        in >> entry.path >> entry.size >> entry.mtime >> entry.crc1 >> entry.crc2 >> entry.md5 >> entry.goodname;
+        entries.insert(entry.path, entry);
+    }
+    QHash<QString, qint64> times;
+    if (version >= 2)
+        in >> times;
+    if (in.status() != QDataStream::Ok)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    m_entries = entries;
+    m_dirTimes = times;
+}
+
+void RomLibrary::saveIndex()
+{
+    QList<RomEntry> entries = getEntries();
+    m_mutex.lock();
+    QHash<QString, qint64> times = m_dirTimes;
+    m_mutex.unlock();
+
+    QSaveFile file(m_indexPath);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32) LIBRARY_INDEX_MAGIC << (quint32) LIBRARY_INDEX_VERSION << (quint32) entries.size();
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const RomEntry &entry = entries.at(i);
+        out << entry.path << entry.size << entry.mtime << entry.crc1 << entry.crc2 << entry.md5 << entry.goodname;
+    }
+    out << times;
+    file.commit();
+}
+
+/* Generates count synthetic ROM images in a temporary directory and hashes
+   them once on a single thread and once on the full pool. The images are
+   still in the page cache afterwards, so this measures the hashing side;
+   drop the caches between runs to measure the disk. */
+int RomLibrary::benchmark(int count)
+{
+    QTemporaryDir dir;
+    if (!dir.isValid() || count <= 0)
+        return 1;
+
+    QVector<RomEntry> entries;
+    QByteArray image(BENCHMARK_ROM_SIZE, 0);
+    uint32_t seed = 0x9E3779B9;
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t *words = (uint32_t *) image.data();
+        for (int j = 0; j < BENCHMARK_ROM_SIZE / 4; ++j)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            words[j] = seed;
+        }
+        /* z64 magic, so every image goes through the normal probe path */
+        unsigned char *header = (unsigned char *) image.data();
+        header[0] = 0x80;
+        header[1] = 0x37;
+        header[2] = 0x12;
+        header[3] = 0x40;
+
+        RomEntry entry;
+        entry.path = dir.filePath(QString("bench%1.z64").arg(i));
+        QFile file(entry.path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(image) != image.size())
+        {
+            printf("couldn't write %s\n", entry.path.toUtf8().constData());
+            return 1;
+        }
+        entries.append(entry);
+    }
+
+    double megabytes = (double) count * BENCHMARK_ROM_SIZE / (1024 * 1024);
+    int threads[2] = { 1, QThread::idealThreadCount() };
+    for (int i = 0; i < 2; ++i)
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threads[i]);
+        QElapsedTimer timer;
+        timer.start();
+        for (int j = 0; j < entries.size(); ++j)
+        {
+            RomEntry *entry = &entries[j];
+            QtConcurrent::run(&pool, [entry]() { probeEntry(*entry); });
+        }
+        pool.waitForDone();
+        double seconds = timer.nsecsElapsed() / 1e9;
+        printf("%d thread(s): %d ROMs, %.0f MB in %.3f s (%.1f MB/s)\n", threads[i], count, megabytes, seconds, megabytes / seconds);
+    }
+    return 0;
+}
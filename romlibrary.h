@@ -0,0 +1,56 @@
+#ifndef ROMLIBRARY_H
+#define ROMLIBRARY_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+
+struct RomEntry {
+    QString path;
+    qint64 size = 0;
+    qint64 mtime = 0;
+    uint32_t crc1 = 0;
+    uint32_t crc2 = 0;
+    QString md5;
+    QString goodname;
+};
+
+class RomLibrary : public QThread
+{
+    Q_OBJECT
+    void run() Q_DECL_OVERRIDE;
+public:
+    explicit RomLibrary(QString indexPath, QObject *parent = 0);
+    void setDirectories(QStringList dirs);
+    void rescan();
+    void refresh();
+    void stop();
+    QList<RomEntry> getEntries();
+    static int benchmark(int count);
+signals:
+    void libraryChanged();
+    void scanProgress(int done, int total);
+private:
+    static void probeEntry(RomEntry &entry);
+    void scan(QStringList dirs);
+    bool directoriesChanged(QStringList dirs);
+    void hashEntries(QVector<RomEntry> &pending);
+    void loadIndex();
+    void saveIndex();
+    QString m_indexPath;
+    QStringList m_dirs;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QThreadPool m_pool;
+    QHash<QString, RomEntry> m_entries;
+    QHash<QString, qint64> m_dirTimes;
+    bool m_rescan = false;
+    bool m_refresh = false;
+};
+
+#endif // ROMLIBRARY_H
@@ -160,7 +160,7 @@ void SettingsDialog::closeEvent(QCloseEvent *event)
     {
         (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &value);
         if (value == M64EMU_STOPPED)
-            w->resetCore();
+            w->refreshCore();
     }
     else
         w->resetCore();
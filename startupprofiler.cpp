@@ -0,0 +1,102 @@
+#include "startupprofiler.h"
+#include "common.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+struct profile_event {
+    const char *name;
+    char phase;
+    qint64 ns;
+    int tid;
+};
+
+static QElapsedTimer profile_clock;
+static QMutex profile_mutex;
+static QVector<struct profile_event> profile_events;
+static QHash<Qt::HANDLE, int> thread_ids;
+static QString profile_output;
+static QAtomicInt profile_finished;
+
+static void record(const char *name, char phase)
+{
+    if (profile_finished.load() || !profile_clock.isValid())
+        return;
+
+    qint64 ns = profile_clock.nsecsElapsed();
+    QMutexLocker locker(&profile_mutex);
+    Qt::HANDLE thread = QThread::currentThreadId();
+    if (!thread_ids.contains(thread))
+        thread_ids.insert(thread, thread_ids.size() + 1);
+    struct profile_event event = { name, phase, ns, thread_ids.value(thread) };
+    profile_events.append(event);
+}
+
+void StartupProfiler::start()
+{
+    profile_clock.start();
+    profile_events.reserve(64);
+    record("main", 'i');
+}
+
+void StartupProfiler::setOutput(QString path)
+{
+    QMutexLocker locker(&profile_mutex);
+    profile_output = path;
+}
+
+void StartupProfiler::begin(const char *name)
+{
+    record(name, 'B');
+}
+
+void StartupProfiler::end(const char *name)
+{
+    record(name, 'E');
+}
+
+void StartupProfiler::mark(const char *name)
+{
+    record(name, 'i');
+}
+
+/* Writes the profile_events in Chrome trace format (chrome://tracing, Perfetto). */
+void StartupProfiler::finish()
+{
+    if (!profile_finished.testAndSetOrdered(0, 1))
+        return;
+
+    QMutexLocker locker(&profile_mutex);
+    if (profile_output.isEmpty())
+        return;
+
+    QJsonArray trace;
+    for (int i = 0; i < profile_events.size(); ++i)
+    {
+        QJsonObject event;
+        event.insert("name", profile_events.at(i).name);
+        event.insert("ph", QString(profile_events.at(i).phase));
+        event.insert("ts", profile_events.at(i).ns / 1000.0);
+        event.insert("pid", 1);
+        event.insert("tid", profile_events.at(i).tid);
+        if (profile_events.at(i).phase == 'i')
+            event.insert("s", "g");
+        trace.append(event);
+    }
+    QJsonObject root;
+    root.insert("traceEvents", trace);
+    root.insert("displayTimeUnit", "ms");
+
+    QFile file(profile_output);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0)
+        DebugMessage(M64MSG_WARNING, "couldn't write startup profile to '%s'.", profile_output.toUtf8().constData());
+    else
+        DebugMessage(M64MSG_INFO, "startup profile written to '%s'", profile_output.toUtf8().constData());
+}
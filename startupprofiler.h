@@ -0,0 +1,20 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QString>
+
+/* Records monotonic timestamps for the startup phases, from main() up to the
+   first presented frame. Recording is always on and stops after finish();
+   the trace is only written when an output file was set (--startup-profile). */
+class StartupProfiler
+{
+public:
+    static void start();
+    static void setOutput(QString path);
+    static void begin(const char *name);
+    static void end(const char *name);
+    static void mark(const char *name);
+    static void finish();
+};
+
+#endif // STARTUPPROFILER_H
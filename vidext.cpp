@@ -3,19 +3,256 @@
 #include "workerthread.h"
 #include "mainwindow.h"
 #include "interface/core_commands.h"
+#include "startupprofiler.h"
+#include "interface/frame_stats.h"
+#include "interface/frame_capture.h"
+#include "presentthread.h"
 #include <stdio.h>
+#include <string.h>
 #include <QDesktopWidget>
 #include <QScreen>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#ifdef SINGLE_THREAD
+#include <QAbstractEventDispatcher>
+#include <QPointer>
+#endif
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+
+#define SWAP_SET_VOLUME  1
+#define SWAP_TOGGLE_FS   2
+#define SWAP_FIRST_FRAME 4
+
+#define CONTEXT_TIMEOUT_MS 10000
+
+#define VSYNC_PLUGIN   -1
+#define VSYNC_ADAPTIVE  2
+#define MAX_QUEUED_FRAMES 3
+#define FENCE_TIMEOUT_NS  100000000
+#define EVENT_FORCE_FRAMES 8
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT    0x00000001
+
+typedef GLenum (QOPENGLF_APIENTRYP ptr_glClientWaitSync)(void *sync, GLbitfield flags, quint64 timeout);
+#if defined(_WIN32)
+typedef const char *(QOPENGLF_APIENTRYP ptr_wglGetExtensionsStringEXT)(void);
+typedef int (QOPENGLF_APIENTRYP ptr_wglSwapIntervalEXT)(int interval);
+#elif defined(__unix__)
+#define GLX_SCREEN 0
+typedef void *(*ptr_glXGetCurrentDisplay)(void);
+typedef unsigned long (*ptr_glXGetCurrentDrawable)(void);
+typedef const char *(*ptr_glXQueryExtensionsString)(void *display, int screen);
+typedef void (*ptr_glXSwapIntervalEXT)(void *display, unsigned long drawable, int interval);
+#endif
 
 static int init;
 static int needs_toggle;
-static int set_volume;
+static int initial_volume;
+/* one-shot work for the next swaps (SWAP_* bits), so the steady-state swap
+   is a single branch: no allocation, no settings I/O and no core queries */
+static int pending_swap;
+/* newest window size, (width << 16) + height, set by the GUI thread and
+   handed to the core by the next swap */
+static QAtomicInt pending_size;
+/* window size in pixels, same encoding. Unlike pending_size it is kept once
+   applied, so presenting a frame never has to ask the window for it */
+static QAtomicInt window_size;
+/* turbo: frames are only presented this often, in us (0 presents all) */
+static QAtomicInt present_interval_us;
+static qint64 last_present_ns;
+static thread_local bool render_thread;
+static OGLWindow *gl_window;
+static QOpenGLContext *gl_context;
 static QSurfaceFormat format;
+/* offscreen mode: the plugin renders into an FBO on an offscreen surface */
+static bool offscreen;
+static QOffscreenSurface *offscreen_surface;
+static QOpenGLFramebufferObject *offscreen_fbo;
+/* present thread mode: the window's context belongs to presenter and
+   gl_context is a shared one the plugin renders with */
+static int present_thread;
+static PresentThread *presenter;
+
+/* Qt can't enumerate or switch display modes, so the modes on offer are the
+   current mode of each attached screen, in the same logical pixels the
+   window is sized in. The emulation thread can't query screens or the main
+   window, so the GUI thread takes this snapshot before each game. */
+struct screen_mode {
+    QSize size;
+    qreal refresh_rate;
+    qreal pixel_ratio;
+    QString name;
+};
+static QVector<struct screen_mode> screen_modes;
+static int current_screen;
+
+/* presentation settings, read once per game in qtVidExtFuncInit */
+static int present_vsync;
+static unsigned long frame_delay_us;
+static int max_queued;
+static void *fences[MAX_QUEUED_FRAMES];
+static int fence_head;
+static ptr_glFenceSync FenceSync;
+static ptr_glClientWaitSync ClientWaitSync;
+static ptr_glDeleteSync DeleteSync;
+
+#ifdef SINGLE_THREAD
+/* GUI events run inside the swap hook in single-threaded builds. Once the
+   per-frame budget is spent, repaints and relayouts are held back until
+   the next frame; input and everything else is still delivered. Every
+   EVENT_FORCE_FRAMES frames nothing is held back, so a pump that always
+   overruns still repaints. */
+class EventBudget : public QObject
+{
+public:
+    bool eventFilter(QObject *object, QEvent *event) Q_DECL_OVERRIDE
+    {
+        if (event->type() != QEvent::UpdateRequest && event->type() != QEvent::LayoutRequest)
+            return false;
+        if (!deferring || frameStatsClock() < deadline)
+            return false;
+        deferred.append(qMakePair(QPointer<QObject>(object), event->type()));
+        return true;
+    }
+    bool deferring = false;
+    qint64 deadline = 0;
+    QList<QPair<QPointer<QObject>, QEvent::Type> > deferred;
+};
+
+static EventBudget *event_budget;
+static qint64 event_budget_ns;
+static int event_frames;
+static int event_overruns;
+#endif
+
+static void setupQueueLimit()
+{
+    fence_head = 0;
+    for (int i = 0; i < MAX_QUEUED_FRAMES; ++i)
+        fences[i] = nullptr;
+    if (!max_queued)
+        return;
+
+    FenceSync = (ptr_glFenceSync) gl_context->getProcAddress("glFenceSync");
+    ClientWaitSync = (ptr_glClientWaitSync) gl_context->getProcAddress("glClientWaitSync");
+    DeleteSync = (ptr_glDeleteSync) gl_context->getProcAddress("glDeleteSync");
+    if (!FenceSync || !ClientWaitSync || !DeleteSync) {
+        DebugMessage(M64MSG_WARNING, "GL sync objects not available, queued frames are not limited");
+        max_queued = 0;
+    }
+}
+
+/* Fences every presented frame and waits for the one max_queued frames back,
+   so the driver never holds more than max_queued frames. Returns the time
+   spent waiting. */
+static qint64 limitQueuedFrames()
+{
+    qint64 start = frameStatsClock();
+    fences[fence_head] = FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fence_head = (fence_head + 1) % max_queued;
+    void *oldest = fences[fence_head];
+    if (oldest) {
+        ClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        DeleteSync(oldest);
+        fences[fence_head] = nullptr;
+    }
+    return frameStatsClock() - start;
+}
+
+static void releaseFences()
+{
+    for (int i = 0; i < MAX_QUEUED_FRAMES; ++i) {
+        if (fences[i])
+            DeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+}
+
+/* Adaptive vsync is swap interval -1, which Qt 5 never passes on to the
+   driver (a negative interval in the format just leaves the driver's
+   default alone). It is set through the window system's swap control
+   extension instead, which needs EXT_swap_control_tear. GLX and WGL only,
+   the context must be current. */
+static bool hasSwapControlTear(QOpenGLContext *context)
+{
+#if defined(_WIN32)
+    ptr_wglGetExtensionsStringEXT GetExtensionsString = (ptr_wglGetExtensionsStringEXT) context->getProcAddress("wglGetExtensionsStringEXT");
+    const char *extensions = GetExtensionsString ? GetExtensionsString() : nullptr;
+    return extensions && strstr(extensions, "WGL_EXT_swap_control_tear");
+#elif defined(__unix__)
+    ptr_glXGetCurrentDisplay GetCurrentDisplay = (ptr_glXGetCurrentDisplay) context->getProcAddress("glXGetCurrentDisplay");
+    ptr_glXQueryExtensionsString QueryExtensionsString = (ptr_glXQueryExtensionsString) context->getProcAddress("glXQueryExtensionsString");
+    void *display = GetCurrentDisplay ? GetCurrentDisplay() : nullptr;
+    const char *extensions = display && QueryExtensionsString ? QueryExtensionsString(display, GLX_SCREEN) : nullptr;
+    return extensions && strstr(extensions, "GLX_EXT_swap_control_tear");
+#else
+    Q_UNUSED(context);
+    return false;
+#endif
+}
+
+static bool setAdaptiveVsync(QOpenGLContext *context)
+{
+    if (!hasSwapControlTear(context))
+        return false;
+#if defined(_WIN32)
+    ptr_wglSwapIntervalEXT SwapInterval = (ptr_wglSwapIntervalEXT) context->getProcAddress("wglSwapIntervalEXT");
+    return SwapInterval && SwapInterval(-1);
+#elif defined(__unix__)
+    ptr_glXGetCurrentDisplay GetCurrentDisplay = (ptr_glXGetCurrentDisplay) context->getProcAddress("glXGetCurrentDisplay");
+    ptr_glXGetCurrentDrawable GetCurrentDrawable = (ptr_glXGetCurrentDrawable) context->getProcAddress("glXGetCurrentDrawable");
+    ptr_glXSwapIntervalEXT SwapInterval = (ptr_glXSwapIntervalEXT) context->getProcAddress("glXSwapIntervalEXT");
+    if (!GetCurrentDrawable || !SwapInterval)
+        return false;
+    SwapInterval(GetCurrentDisplay(), GetCurrentDrawable(), -1);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* Called by the GUI thread, which checks once on a throwaway context
+   whether the Adaptive option can be offered. */
+bool qtVidExtAdaptiveVsyncSupported()
+{
+    static int supported = -1;
+    if (supported != -1)
+        return supported;
+
+    supported = 0;
+    QOffscreenSurface surface;
+    surface.create();
+    QOpenGLContext context;
+    if (surface.isValid() && context.create() && context.makeCurrent(&surface)) {
+        supported = hasSwapControlTear(&context);
+        context.doneCurrent();
+    }
+    return supported;
+}
 
 m64p_error qtVidExtFuncInit(void)
 {
     init = 0;
-    set_volume = 1;
+    QSettings settings(w->getSettings()->fileName(), QSettings::IniFormat);
+    initial_volume = settings.value("volume").toInt();
+    present_vsync = settings.value("vsync", VSYNC_PLUGIN).toInt();
+    frame_delay_us = settings.value("frameDelay").toInt() * 1000;
+    max_queued = qBound(0, settings.value("maxQueuedFrames").toInt(), MAX_QUEUED_FRAMES);
+    offscreen = w->getOffscreen();
+#ifdef SINGLE_THREAD
+    event_budget_ns = qMax(1, settings.value("eventBudget", 2).toInt()) * 1000000LL;
+    event_frames = 0;
+    event_overruns = 0;
+    event_budget = new EventBudget;
+    QCoreApplication::instance()->installEventFilter(event_budget);
+#endif
+#ifndef SINGLE_THREAD
+    present_thread = settings.value("presentThread").toInt() && !offscreen;
+#endif
+    pending_swap = SWAP_SET_VOLUME | SWAP_FIRST_FRAME;
     format = QSurfaceFormat::defaultFormat();
     format.setOption(QSurfaceFormat::DeprecatedFunctions, 1);
     format.setDepthBufferSize(24);
@@ -27,63 +264,250 @@ m64p_error qtVidExtFuncInit(void)
         format.setRenderableType(QSurfaceFormat::OpenGLES);
 
     w->setRenderingThread(QThread::currentThread());
+    render_thread = true;
     return M64ERR_SUCCESS;
 }
 
 m64p_error qtVidExtFuncQuit(void)
 {
     init = 0;
-    w->getWorkerThread()->toggleFS(M64VIDEO_WINDOWED);
-    w->getOGLWindow()->doneCurrent();
+    pending_swap = 0;
+    pending_size.store(0);
+    present_interval_us.store(0);
+    render_thread = false;
+    if (max_queued)
+        releaseFences();
+    if (gl_context)
+        frameCaptureRelease(gl_context);
+    if (presenter) {
+        presenter->stop();
+        delete presenter;
+        presenter = nullptr;
+        gl_context->doneCurrent();
+        delete gl_context;
+        w->getWorkerThread()->toggleFS(M64VIDEO_WINDOWED);
+    } else if (offscreen) {
+        delete offscreen_fbo;
+        offscreen_fbo = nullptr;
+        if (gl_context)
+            gl_context->doneCurrent();
+        delete gl_context;
+        offscreen_surface = nullptr;
+    } else {
+        w->getWorkerThread()->toggleFS(M64VIDEO_WINDOWED);
+        w->getOGLWindow()->doneCurrent();
 #ifndef SINGLE_THREAD
-    w->getOGLWindow()->context()->moveToThread(QApplication::instance()->thread());
+        w->getOGLWindow()->context()->moveToThread(QApplication::instance()->thread());
 #endif
+    }
+    gl_window = nullptr;
+    gl_context = nullptr;
     w->getWorkerThread()->deleteOGLWindow();
+#ifdef SINGLE_THREAD
+    QCoreApplication::instance()->removeEventFilter(event_budget);
+    delete event_budget;
+    event_budget = nullptr;
+    if (event_frames)
+        DebugMessage(M64MSG_INFO, "event pump went over its %d ms budget in %d of %d frames",
+                     (int) (event_budget_ns / 1000000), event_overruns, event_frames);
+#endif
     return M64ERR_SUCCESS;
 }
 
 m64p_error qtVidExtFuncListModes(m64p_2d_size *SizeArray, int *NumSizes)
 {
-    QList<QScreen *> screens = QGuiApplication::screens();
-    QRect size = screens.first()->geometry();
-    SizeArray[0].uiWidth = size.width();
-    SizeArray[0].uiHeight = size.height();
-    *NumSizes = 1;
+    int count = 0;
+    for (int i = 0; i < screen_modes.size() && count < *NumSizes; ++i) {
+        QSize size = screen_modes.at(i).size;
+        bool duplicate = false;
+        for (int j = 0; j < count; ++j)
+            duplicate |= SizeArray[j].uiWidth == (unsigned int) size.width() && SizeArray[j].uiHeight == (unsigned int) size.height();
+        if (duplicate)
+            continue;
+        SizeArray[count].uiWidth = size.width();
+        SizeArray[count].uiHeight = size.height();
+        ++count;
+    }
+    *NumSizes = count;
     return M64ERR_SUCCESS;
 }
 
-m64p_error qtVidExtFuncListRates(m64p_2d_size, int*, int*)
+m64p_error qtVidExtFuncListRates(m64p_2d_size Size, int *NumRates, int *Rates)
 {
-    return M64ERR_UNSUPPORTED;
+    int count = 0;
+    for (int i = 0; i < screen_modes.size() && count < *NumRates; ++i) {
+        QSize size = screen_modes.at(i).size;
+        if (size.width() != (int) Size.uiWidth || size.height() != (int) Size.uiHeight)
+            continue;
+        int rate = qRound(screen_modes.at(i).refresh_rate);
+        bool duplicate = false;
+        for (int j = 0; j < count; ++j)
+            duplicate |= Rates[j] == rate;
+        if (!duplicate)
+            Rates[count++] = rate;
+    }
+    *NumRates = count;
+    return M64ERR_SUCCESS;
+}
+
+static void resizeOffscreen(int width, int height)
+{
+    if (offscreen_fbo && offscreen_fbo->size() == QSize(width, height))
+        return;
+    delete offscreen_fbo;
+    offscreen_fbo = new QOpenGLFramebufferObject(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+    offscreen_fbo->bind();
+}
+
+/* The surface is created by the GUI thread, the context lives on the
+   rendering thread like the window's does. Works on any platform plugin
+   with GL support. Qt 5's offscreen platform plugin still creates its GL
+   contexts through GLX or EGL, so a display is needed either way; a
+   virtual one such as Xvfb is enough for headless runs. */
+static bool setupOffscreen(int width, int height)
+{
+    offscreen_surface = w->getOffscreenSurface();
+    gl_context = new QOpenGLContext;
+    gl_context->setFormat(format);
+    if (!offscreen_surface || !offscreen_surface->isValid() || !gl_context->create() || !gl_context->makeCurrent(offscreen_surface)) {
+        DebugMessage(M64MSG_ERROR, "couldn't create an offscreen OpenGL context");
+        delete gl_context;
+        gl_context = nullptr;
+        return false;
+    }
+    resizeOffscreen(width, height);
+    return true;
+}
+
+static QSize windowSize()
+{
+    int size = window_size.load();
+    return QSize(size >> 16, size & 0xffff);
+}
+
+/* Hands the window's context to a present thread and renders with a
+   context shared with it, on an offscreen surface. Falls back to swapping
+   on this thread when that isn't possible. Only plugins that draw to
+   qtVidExtFuncGLGetDefaultFramebuffer() show up in this mode. */
+static void setupPresentThread()
+{
+    w->getWorkerThread()->createOffscreenSurface(&format);
+    QOffscreenSurface *surface = w->getOffscreenSurface();
+    QOpenGLContext *render_context = new QOpenGLContext;
+    render_context->setFormat(gl_context->format());
+    render_context->setShareContext(gl_context);
+    gl_context->doneCurrent();
+    if (surface && surface->isValid() && render_context->create() && render_context->makeCurrent(surface)) {
+        presenter = new PresentThread(gl_window, gl_context);
+        if (presenter->setup(render_context, windowSize())) {
+            gl_context = render_context;
+            return;
+        }
+        delete presenter;
+        presenter = nullptr;
+        render_context->doneCurrent();
+    }
+    DebugMessage(M64MSG_WARNING, "present thread not available, presenting on the emulation thread");
+    delete render_context;
+    gl_context->makeCurrent(gl_window);
+}
+
+/* size of the image being presented, in pixels */
+static QSize presentSize()
+{
+    if (presenter)
+        return presenter->size();
+    if (offscreen_fbo)
+        return offscreen_fbo->size();
+    return windowSize();
 }
 
 m64p_error qtVidExtFuncSetMode(int Width, int Height, int, int ScreenMode, int)
 {
     if (!init) {
-        w->getWorkerThread()->createOGLWindow(&format);
+        StartupProfiler::begin("create window");
+        if (present_vsync == VSYNC_ADAPTIVE)
+            format.setSwapInterval(-1);
+        else if (present_vsync != VSYNC_PLUGIN)
+            format.setSwapInterval(present_vsync);
+        if (offscreen) {
+            w->getWorkerThread()->createOffscreenSurface(&format);
+            if (!setupOffscreen(Width, Height)) {
+                StartupProfiler::end("create window");
+                return M64ERR_SYSTEM_FAIL;
+            }
+        } else {
+            /* until the window's first resize event comes in */
+            qreal ratio = current_screen >= 0 && current_screen < screen_modes.size() ? screen_modes.at(current_screen).pixel_ratio : 1;
+            window_size.store((qRound(Width * ratio) << 16) + qRound(Height * ratio));
+            w->getWorkerThread()->createOGLWindow(&format);
 #ifdef SINGLE_THREAD
-        QCoreApplication::processEvents();
+            QCoreApplication::processEvents();
 #else
-        while (!w->getOGLWindow()->isValid()) {}
-        while (w->getOGLWindow()->context()->thread() != w->getRenderingThread()) {}
+            if (!w->getOGLWindow()->waitForContext(CONTEXT_TIMEOUT_MS)) {
+                DebugMessage(M64MSG_ERROR, "OpenGL context was not ready after %d ms", CONTEXT_TIMEOUT_MS);
+                StartupProfiler::end("create window");
+                return M64ERR_SYSTEM_FAIL;
+            }
 #endif
-        w->getWorkerThread()->resizeMainWindow(Width, Height);
-        w->getOGLWindow()->makeCurrent();
+            w->getWorkerThread()->resizeMainWindow(Width, Height);
+            w->getOGLWindow()->makeCurrent();
+            gl_window = w->getOGLWindow();
+            gl_context = gl_window->context();
+            if (present_vsync == VSYNC_ADAPTIVE && !setAdaptiveVsync(gl_context))
+                DebugMessage(M64MSG_WARNING, "adaptive vsync is not supported, using the driver's swap interval");
+            if (present_thread)
+                setupPresentThread();
+        }
+        setupQueueLimit();
+        /* the delay only moves the next frame's input poll closer to the
+           display when the swap itself waits for vblank on this thread;
+           otherwise the core's speed limiter just sleeps that much less */
+        if (frame_delay_us && (!gl_window || presenter || gl_window->format().swapInterval() == 0)) {
+            DebugMessage(M64MSG_WARNING, "frame delay needs vsync and no present thread, it is disabled");
+            frame_delay_us = 0;
+        }
+        StartupProfiler::end("create window");
         init = 1;
-        needs_toggle = ScreenMode;
+        needs_toggle = offscreen ? 0 : ScreenMode;
+        if (needs_toggle)
+            pending_swap |= SWAP_TOGGLE_FS;
     }
     return M64ERR_SUCCESS;
 }
 
-m64p_error qtVidExtFuncSetModeWithRate(int, int, int, int, int, int)
+/* Picks the screen to run on: one showing the requested size at a refresh
+   rate that is a whole multiple of RefreshRate, preferring the screen the
+   window is already on. The window is moved there before SetMode makes it
+   fullscreen; the screen's mode itself is left as it is. */
+m64p_error qtVidExtFuncSetModeWithRate(int Width, int Height, int RefreshRate, int BitsPerPixel, int ScreenMode, int Flags)
 {
-    return M64ERR_UNSUPPORTED;
+    int chosen = -1;
+    for (int i = 0; i < screen_modes.size(); ++i) {
+        QSize size = screen_modes.at(i).size;
+        int rate = qRound(screen_modes.at(i).refresh_rate);
+        if (size.width() != Width || size.height() != Height || RefreshRate <= 0 || rate % RefreshRate != 0)
+            continue;
+        if (chosen == -1 || i == current_screen)
+            chosen = i;
+    }
+
+    if (chosen == -1) {
+        DebugMessage(M64MSG_WARNING, "no screen shows %dx%d at a multiple of %d Hz, staying on the current screen", Width, Height, RefreshRate);
+    } else {
+        DebugMessage(M64MSG_INFO, "using screen %d (%s) at %.2f Hz for %d Hz", chosen, screen_modes.at(chosen).name.toUtf8().constData(),
+                     screen_modes.at(chosen).refresh_rate, RefreshRate);
+        if (chosen != current_screen)
+            w->getWorkerThread()->moveToScreen(chosen);
+    }
+
+    return qtVidExtFuncSetMode(Width, Height, BitsPerPixel, ScreenMode, Flags);
 }
 
 m64p_function qtVidExtFuncGLGetProc(const char* Proc)
 {
     if (!init) return NULL;
-    return w->getOGLWindow()->context()->getProcAddress(Proc);
+    return gl_context->getProcAddress(Proc);
 }
 
 m64p_error qtVidExtFuncGLSetAttr(m64p_GLattr Attr, int Value)
@@ -145,10 +569,15 @@ m64p_error qtVidExtFuncGLSetAttr(m64p_GLattr Attr, int Value)
     return M64ERR_SUCCESS;
 }
 
+static QSurfaceFormat surfaceFormat()
+{
+    return gl_window ? gl_window->format() : gl_context->format();
+}
+
 m64p_error qtVidExtFuncGLGetAttr(m64p_GLattr Attr, int *pValue)
 {
     if (!init) return M64ERR_NOT_INIT;
-    QSurfaceFormat::SwapBehavior SB = w->getOGLWindow()->format().swapBehavior();
+    QSurfaceFormat::SwapBehavior SB = surfaceFormat().swapBehavior();
     switch (Attr) {
     case M64P_GL_DOUBLEBUFFER:
         if (SB == QSurfaceFormat::SingleBuffer)
@@ -157,39 +586,39 @@ m64p_error qtVidExtFuncGLGetAttr(m64p_GLattr Attr, int *pValue)
             *pValue = 1;
         break;
     case M64P_GL_BUFFER_SIZE:
-        *pValue = w->getOGLWindow()->format().alphaBufferSize() + w->getOGLWindow()->format().redBufferSize() + w->getOGLWindow()->format().greenBufferSize() + w->getOGLWindow()->format().blueBufferSize();
+        *pValue = surfaceFormat().alphaBufferSize() + surfaceFormat().redBufferSize() + surfaceFormat().greenBufferSize() + surfaceFormat().blueBufferSize();
         break;
     case M64P_GL_DEPTH_SIZE:
-        *pValue = w->getOGLWindow()->format().depthBufferSize();
+        *pValue = surfaceFormat().depthBufferSize();
         break;
     case M64P_GL_RED_SIZE:
-        *pValue = w->getOGLWindow()->format().redBufferSize();
+        *pValue = surfaceFormat().redBufferSize();
         break;
     case M64P_GL_GREEN_SIZE:
-        *pValue = w->getOGLWindow()->format().greenBufferSize();
+        *pValue = surfaceFormat().greenBufferSize();
         break;
     case M64P_GL_BLUE_SIZE:
-        *pValue = w->getOGLWindow()->format().blueBufferSize();
+        *pValue = surfaceFormat().blueBufferSize();
         break;
     case M64P_GL_ALPHA_SIZE:
-        *pValue = w->getOGLWindow()->format().alphaBufferSize();
+        *pValue = surfaceFormat().alphaBufferSize();
         break;
     case M64P_GL_SWAP_CONTROL:
-        *pValue = w->getOGLWindow()->format().swapInterval();
+        *pValue = surfaceFormat().swapInterval();
         break;
     case M64P_GL_MULTISAMPLEBUFFERS:
         break;
     case M64P_GL_MULTISAMPLESAMPLES:
-        *pValue = w->getOGLWindow()->format().samples();
+        *pValue = surfaceFormat().samples();
         break;
     case M64P_GL_CONTEXT_MAJOR_VERSION:
-        *pValue = w->getOGLWindow()->format().majorVersion();
+        *pValue = surfaceFormat().majorVersion();
         break;
     case M64P_GL_CONTEXT_MINOR_VERSION:
-        *pValue = w->getOGLWindow()->format().minorVersion();
+        *pValue = surfaceFormat().minorVersion();
         break;
     case M64P_GL_CONTEXT_PROFILE_MASK:
-        switch (w->getOGLWindow()->format().profile()) {
+        switch (surfaceFormat().profile()) {
         case QSurfaceFormat::CoreProfile:
             *pValue = M64P_GL_CONTEXT_PROFILE_CORE;
             break;
@@ -205,39 +634,200 @@ m64p_error qtVidExtFuncGLGetAttr(m64p_GLattr Attr, int *pValue)
     return M64ERR_SUCCESS;
 }
 
-m64p_error qtVidExtFuncGLSwapBuf(void)
+static void setVideoSize(int size)
 {
-    if (set_volume) {
-        int value;
-        (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &value);
-        if (value == M64EMU_RUNNING) {
-            QSettings settings(w->getSettings()->fileName(), QSettings::IniFormat);
-            int volume = settings.value("volume").toInt();
-            (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_AUDIO_VOLUME, &volume);
-            set_volume = 0;
-        }
+    int current_size = 0;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_VIDEO_SIZE, &current_size);
+    if (current_size != size)
+        (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_VIDEO_SIZE, &size);
+}
+
+/* Called by the GUI thread on every window resize. While the game runs the
+   size is only stored, so a drag or a fullscreen switch reaches the core
+   as one update at the next frame boundary; when no frames are being
+   swapped it is applied right away. */
+void qtVidExtResize(int width, int height)
+{
+    int size = (width << 16) + height;
+    window_size.store(size);
+    int state = M64EMU_STOPPED;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &state);
+    if (state == M64EMU_RUNNING)
+        pending_size.store(size);
+    else
+        setVideoSize(size);
+}
+
+static void applyPendingSwap()
+{
+    int size = pending_size.fetchAndStoreOrdered(0);
+    if (size)
+        setVideoSize(size);
+    if (!pending_swap)
+        return;
+
+    int value;
+    (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &value);
+
+    if ((pending_swap & SWAP_SET_VOLUME) && value == M64EMU_RUNNING) {
+        (*CoreDoCommand)(M64CMD_CORE_STATE_SET, M64CORE_AUDIO_VOLUME, &initial_volume);
+        pending_swap &= ~SWAP_SET_VOLUME;
     }
 
-    if (needs_toggle) {
-        int value;
-        (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_EMU_STATE, &value);
-        if (value > M64EMU_STOPPED) {
-            w->getWorkerThread()->toggleFS(needs_toggle);
-            needs_toggle = 0;
+    if ((pending_swap & SWAP_TOGGLE_FS) && value > M64EMU_STOPPED) {
+        w->getWorkerThread()->toggleFS(needs_toggle);
+        needs_toggle = 0;
+        pending_swap &= ~SWAP_TOGGLE_FS;
+    }
+}
+
+/* Called by the GUI thread before the emulation thread starts. */
+void qtVidExtUpdateScreens(QScreen *current)
+{
+    QList<QScreen *> screens = QGuiApplication::screens();
+    screen_modes.clear();
+    for (int i = 0; i < screens.size(); ++i) {
+        struct screen_mode mode;
+        mode.size = screens.at(i)->size();
+        mode.refresh_rate = screens.at(i)->refreshRate();
+        mode.pixel_ratio = screens.at(i)->devicePixelRatio();
+        mode.name = screens.at(i)->name();
+        screen_modes.append(mode);
+    }
+    current_screen = screens.indexOf(current ? current : QGuiApplication::primaryScreen());
+}
+
+/* Called by the GUI thread. While interval_us is set, frames that come
+   sooner than that after the last presented one are dropped instead of
+   swapped, so fast-forward isn't bound by vsync or the compositor. */
+void qtVidExtSetPresentInterval(int interval_us)
+{
+    present_interval_us.store(interval_us);
+}
+
+#ifdef SINGLE_THREAD
+static void pumpEvents()
+{
+    qint64 start = frameStatsClock();
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    event_budget->deadline = start + event_budget_ns;
+    event_budget->deferring = event_frames % EVENT_FORCE_FRAMES != 0;
+    /* the first pass always runs, so input is delivered every frame */
+    while (dispatcher->processEvents(QEventLoop::AllEvents) && frameStatsClock() < event_budget->deadline);
+    event_budget->deferring = false;
+
+    for (int i = 0; i < event_budget->deferred.size(); ++i) {
+        if (event_budget->deferred.at(i).first)
+            QCoreApplication::postEvent(event_budget->deferred.at(i).first, new QEvent(event_budget->deferred.at(i).second));
+    }
+    event_budget->deferred.clear();
+
+    ++event_frames;
+    if (frameStatsClock() - start > event_budget_ns)
+        ++event_overruns;
+}
+#endif
+
+m64p_error qtVidExtFuncGLSwapBuf(void)
+{
+    if (pending_swap | pending_size.load())
+        applyPendingSwap();
+
+    qint64 frame_ns = frameStatsClock();
+    qint64 wait_ns = 0;
+    int interval_us = present_interval_us.load();
+    /* a skipped frame is drawn over by the next one, it isn't captured,
+       presented or fenced */
+    if (render_thread && gl_context && (!interval_us || frame_ns - last_present_ns >= interval_us * 1000LL)) {
+        last_present_ns = frame_ns;
+        if (frameCaptureActive()) {
+            QSize size = presentSize();
+            frameCaptureFrame(gl_context, qtVidExtFuncGLGetDefaultFramebuffer(), size.width(), size.height());
+        }
+        if (presenter) {
+            presenter->submit(windowSize());
+        } else if (gl_window) {
+            gl_context->swapBuffers(gl_window);
+            gl_context->makeCurrent(gl_window);
+        } else {
+            gl_context->functions()->glFlush();
         }
+        if (max_queued)
+            wait_ns = limitQueuedFrames();
     }
+    frameStatsRecord(frame_ns, frameStatsClock() - frame_ns - wait_ns, wait_ns);
 
-    if (QThread::currentThread() == w->getRenderingThread()) {
-        w->getOGLWindow()->context()->swapBuffers(w->getOGLWindow());
-        w->getOGLWindow()->context()->makeCurrent(w->getOGLWindow());
+    /* start emulating (and polling input for) the next frame as late as
+       possible, so it is presented closer to when the input was read. Only
+       armed when the swap above waited for vblank (see SetMode). */
+    if (frame_delay_us && !interval_us)
+        QThread::usleep(frame_delay_us);
+
+    if (pending_swap & SWAP_FIRST_FRAME) {
+        StartupProfiler::mark("first frame");
+        StartupProfiler::finish();
+        pending_swap &= ~SWAP_FIRST_FRAME;
     }
 
 #ifdef SINGLE_THREAD
-    QCoreApplication::processEvents();
+    pumpEvents();
 #endif
     return M64ERR_SUCCESS;
 }
 
+/* Times the swap hook on an offscreen context rendering into an FBO, the
+   path --offscreen takes: everything the frontend adds to a frame plus the
+   flush, without a wait for the display. */
+int qtVidExtSwapBenchmark(int frames)
+{
+    if (frames <= 0)
+        return 1;
+
+    QOffscreenSurface surface;
+    surface.create();
+    QOpenGLContext context;
+    if (!surface.isValid() || !context.create() || !context.makeCurrent(&surface)) {
+        printf("swap hook: couldn't create an offscreen OpenGL context\n");
+        return 1;
+    }
+    QOpenGLFramebufferObject fbo(640, 480, QOpenGLFramebufferObject::CombinedDepthStencil);
+    fbo.bind();
+
+    pending_swap = 0;
+    pending_size.store(0);
+    present_interval_us.store(0);
+    render_thread = true;
+    gl_window = nullptr;
+    gl_context = &context;
+    offscreen_fbo = &fbo;
+    frame_delay_us = 0;
+    max_queued = 0;
+#ifdef SINGLE_THREAD
+    EventBudget budget;
+    event_budget = &budget;
+    event_budget_ns = 2000000;
+#endif
+    frameStatsReset(60);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; ++i)
+        qtVidExtFuncGLSwapBuf();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    render_thread = false;
+    gl_context = nullptr;
+    offscreen_fbo = nullptr;
+#ifdef SINGLE_THREAD
+    event_budget = nullptr;
+#endif
+    fbo.release();
+    context.doneCurrent();
+
+    printf("swap hook: %d calls, %.1f ns per call\n", frames, (double) elapsed / frames);
+    return 0;
+}
+
 m64p_error qtVidExtFuncSetCaption(const char *)
 {
     return M64ERR_SUCCESS;
@@ -245,7 +835,9 @@ m64p_error qtVidExtFuncSetCaption(const char *)
 
 m64p_error qtVidExtFuncToggleFS(void)
 {
-    if (QThread::currentThread() == w->getRenderingThread())
+    if (offscreen)
+        return M64ERR_SUCCESS;
+    if (render_thread)
         w->getWorkerThread()->toggleFS(M64VIDEO_NONE);
     else
         w->toggleFS(M64VIDEO_NONE);
@@ -255,6 +847,12 @@ m64p_error qtVidExtFuncToggleFS(void)
 
 m64p_error qtVidExtFuncResizeWindow(int width, int height)
 {
+    if (offscreen) {
+        if (offscreen_fbo)
+            resizeOffscreen(width, height);
+        return M64ERR_SUCCESS;
+    }
+
     int response = M64VIDEO_NONE;
     (*CoreDoCommand)(M64CMD_CORE_STATE_QUERY, M64CORE_VIDEO_MODE, &response);
     if (response == M64VIDEO_WINDOWED)
@@ -270,5 +868,7 @@ m64p_error qtVidExtFuncResizeWindow(int width, int height)
 
 uint32_t qtVidExtFuncGLGetDefaultFramebuffer(void)
 {
-    return 0;
+    if (presenter)
+        return presenter->framebuffer();
+    return offscreen_fbo ? offscreen_fbo->handle() : 0;
 }
@@ -6,6 +6,13 @@
 #ifdef __cplusplus
 
 #include "oglwindow.h"
+#include <QScreen>
+
+int qtVidExtSwapBenchmark(int frames);
+void qtVidExtResize(int width, int height);
+void qtVidExtSetPresentInterval(int interval_us);
+void qtVidExtUpdateScreens(QScreen *current);
+bool qtVidExtAdaptiveVsyncSupported();
 
 extern "C" {
 #endif
@@ -3,16 +3,23 @@
 #include "vidext.h"
 #include "mainwindow.h"
 #include "interface/core_commands.h"
+#include "startupprofiler.h"
+#include "interface/thread_sched.h"
 #ifndef _WIN32
 #include <QDBusConnection>
 #include <QDBusReply>
 #include <QDBusInterface>
 #endif
 
+/* Only creating and deleting the GL surfaces waits for the GUI thread,
+   the emulation thread can't continue without them. Everything else is
+   posted, so a busy GUI (a modal dialog, say) never stalls emulation. */
 #ifdef SINGLE_THREAD
 #define CONNECTION_TYPE Qt::AutoConnection
+#define POSTED_CONNECTION_TYPE Qt::AutoConnection
 #else
 #define CONNECTION_TYPE Qt::BlockingQueuedConnection
+#define POSTED_CONNECTION_TYPE Qt::QueuedConnection
 #endif
 
 WorkerThread::WorkerThread(QString _netplay_ip, int _netplay_port, int _netplay_player, QObject *parent)
@@ -33,13 +40,20 @@ void WorkerThread::start()
 void WorkerThread::run()
 #endif
 {
-    connect(this, SIGNAL(resizeMainWindow(int,int)), w, SLOT(resizeMainWindow(int, int)), CONNECTION_TYPE);
-    connect(this, SIGNAL(toggleFS(int)), w, SLOT(toggleFS(int)), CONNECTION_TYPE);
+#ifndef SINGLE_THREAD
+    /* in single-threaded builds this is the GUI thread, which is left alone */
+    threadSchedApply("emulation thread", "emu");
+#endif
+    qRegisterMetaType<DiscordActivity>("DiscordActivity");
+    connect(this, SIGNAL(resizeMainWindow(int,int)), w, SLOT(resizeMainWindow(int, int)), POSTED_CONNECTION_TYPE);
+    connect(this, SIGNAL(toggleFS(int)), w, SLOT(toggleFS(int)), POSTED_CONNECTION_TYPE);
+    connect(this, SIGNAL(moveToScreen(int)), w, SLOT(moveToScreen(int)), POSTED_CONNECTION_TYPE);
     connect(this, SIGNAL(createOGLWindow(QSurfaceFormat*)), w, SLOT(createOGLWindow(QSurfaceFormat*)), CONNECTION_TYPE);
+    connect(this, SIGNAL(createOffscreenSurface(QSurfaceFormat*)), w, SLOT(createOffscreenSurface(QSurfaceFormat*)), CONNECTION_TYPE);
     connect(this, SIGNAL(deleteOGLWindow()), w, SLOT(deleteOGLWindow()), CONNECTION_TYPE);
-    connect(this, SIGNAL(showMessage(QString)), w, SLOT(showMessage(QString)), CONNECTION_TYPE);
-    connect(this, SIGNAL(updateDiscordActivity(struct DiscordActivity)), w, SLOT(updateDiscordActivity(struct DiscordActivity)), CONNECTION_TYPE);
-    connect(this, SIGNAL(clearDiscordActivity()), w, SLOT(clearDiscordActivity()), CONNECTION_TYPE);
+    connect(this, SIGNAL(showMessage(QString)), w, SLOT(showMessage(QString)), POSTED_CONNECTION_TYPE);
+    connect(this, SIGNAL(updateDiscordActivity(struct DiscordActivity)), w, SLOT(updateDiscordActivity(struct DiscordActivity)), POSTED_CONNECTION_TYPE);
+    connect(this, SIGNAL(clearDiscordActivity()), w, SLOT(clearDiscordActivity()), POSTED_CONNECTION_TYPE);
 #ifdef _WIN32
     SetThreadExecutionState(ES_CONTINUOUS | ES_DISPLAY_REQUIRED);
 #else
@@ -52,7 +66,9 @@ void WorkerThread::run()
     }
 #endif
 
+    StartupProfiler::begin("loadROM");
     m64p_error res = loadROM(m_fileName.toStdString());
+    StartupProfiler::end("loadROM");
     if (res == M64ERR_SUCCESS)
     {
         m64p_rom_settings rom_settings;
@@ -87,7 +103,7 @@ void WorkerThread::run()
     if (res == M64ERR_SUCCESS)
         (*ConfigSaveFile)();
 
-    if (w->getNoGUI())
+    if (w->getNoGUI() || w->getOffscreen())
         QApplication::quit();
 }
 
@@ -8,6 +8,8 @@
 #include "common.h"
 #include "discord/discord_game_sdk.h"
 
+Q_DECLARE_METATYPE(DiscordActivity)
+
 class WorkerThread
 #ifndef SINGLE_THREAD
  : public QThread
@@ -28,7 +30,9 @@ public:
 signals:
     void resizeMainWindow(int Width, int Height);
     void toggleFS(int force);
+    void moveToScreen(int index);
     void createOGLWindow(QSurfaceFormat* format);
+    void createOffscreenSurface(QSurfaceFormat* format);
     void deleteOGLWindow();
     void showMessage(QString message);
     void updateDiscordActivity(struct DiscordActivity activity);